@@ -16,26 +16,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"      //load an image using STB_image
 #include "FlareMap.h"
+#include "TextureCache.h"   //one texture per image path, however often it is loaded
 #include <SDL_mixer.h>
 
-//function to load textures
-GLuint LoadTexture(const char *filePath) {
-    int w,h,comp;
-    unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-    if(image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
-    }
-    GLuint retTexture;
-    glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    stbi_image_free(image);
-    return retTexture;
-}
-
 //************************************
 //Global variables begin here
 //************************************
@@ -50,6 +33,7 @@ const int MAX_TIMESTEPS = 60;
 const float FIXED_TIMESTEP = 1.0/MAX_TIMESTEPS;
 glm::vec3 gravity = glm::vec3(0.0f, -1.2f, 0.0f);
 glm::vec3 friction = glm::vec3(1.0f, 0.0f, 0.0f);
+TextureCache texture_cache;     //every texture the game has loaded
 GLuint SPRITE_SHEET;
 Mix_Chunk *jumpSound;
 Mix_Chunk *coinSound;
@@ -420,13 +404,13 @@ void Setup(GameState& state) {
     glm::mat4 viewMatrix = glm::mat4(1.0f);
     
     //use set the view and projection matrix to shader
-    glUseProgram(textured_program.programID);
+    textured_program.Use();
     textured_program.SetProjectionMatrix(projectionMatrix);
     textured_program.SetViewMatrix(viewMatrix);
     glEnable(GL_BLEND); //enable blending
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  //set alpha blend function
     
-    SPRITE_SHEET = LoadTexture(RESOURCE_FOLDER"spritesheet_rgba.png");
+    SPRITE_SHEET = texture_cache.Acquire(RESOURCE_FOLDER"spritesheet_rgba.png");
     state.map.Load(RESOURCE_FOLDER"mymap.txt");
     
     for(FlareMapEntity &entity : state.map.entities) {
@@ -492,7 +476,11 @@ int main(int argc, char *argv[])
         DrawTilemap(textured_program, SPRITE_SHEET, 30, 30, state);
         Render_Game_Level(state);
         SDL_GL_SwapWindow(displayWindow);
+        ShaderProgram::ResetCounters();     //fold the frame's skipped calls into the totals printed at exit
     }
+    texture_cache.PrintStats();
+    ShaderProgram::PrintCounters();
+    texture_cache.Clear();
     SDL_Quit();
     return 0;
 }
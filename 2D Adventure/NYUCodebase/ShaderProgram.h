@@ -16,6 +16,9 @@ class ShaderProgram {
 		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
 		void Cleanup();
 
+		// binds the program unless it is already the one in use
+		void Use();
+
 		void SetModelMatrix(const glm::mat4 &matrix);
         void SetProjectionMatrix(const glm::mat4 &matrix);
         void SetViewMatrix(const glm::mat4 &matrix);
@@ -37,4 +40,32 @@ class ShaderProgram {
     
         GLuint vertexShader;
         GLuint fragmentShader;
+	
+		// Last values uploaded to each uniform. The setters skip the bind and the
+		// upload when a uniform already holds the value it is given.
+		glm::mat4 modelMatrix;
+		glm::mat4 projectionMatrix;
+		glm::mat4 viewMatrix;
+		float color[4];
+		bool modelMatrixSet;
+		bool projectionMatrixSet;
+		bool viewMatrixSet;
+		bool colorSet;
+	
+		// program bound by the last Use, shared by every ShaderProgram
+		static GLuint boundProgram;
+	
+		// GL calls avoided since the last ResetCounters: glUseProgram calls
+		// skipped because the program was bound already, and uniform uploads
+		// skipped because the value had not changed. Reset once per frame.
+		static int skippedBinds;
+		static int skippedUploads;
+		// adds the frame's counts to the totals below, then zeroes them
+		static void ResetCounters();
+		// writes the totals and the per-frame average to std::cout
+		static void PrintCounters();
+	
+		static long totalSkippedBinds;
+		static long totalSkippedUploads;
+		static int countedFrames;
 };
@@ -0,0 +1,142 @@
+#include "RenderQueue.h"
+#include <cstring>
+
+uint64_t RenderSortKey(unsigned int layer, GLuint programID, GLuint textureID, float depth) {
+    // flip float bits so that unsigned comparison orders them like the floats
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+    depthBits = (depthBits & 0x80000000u) ? ~depthBits : depthBits | 0x80000000u;
+    return ((uint64_t)(layer & 0xFF) << 56) | ((uint64_t)(programID & 0xFF) << 48) |
+           ((uint64_t)(textureID & 0xFFFF) << 32) | depthBits;
+}
+
+RenderQueue::RenderQueue() : programChanges(0), textureChanges(0), drawCalls(0), streamBuffer(0) {}
+
+void RenderQueue::Submit(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                         GLuint vertexBuffer, GLsizei vertexCount, GLint firstVertex) {
+    if (vertexCount <= 0) {
+        return;
+    }
+    RenderCommand command;
+    command.key = key;
+    command.program = &program;
+    command.textureID = textureID;
+    command.modelMatrix = modelMatrix;
+    command.vertexBuffer = vertexBuffer;
+    command.firstVertex = firstVertex;
+    command.vertexCount = vertexCount;
+    commands.push_back(command);
+}
+
+void RenderQueue::SubmitVertices(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                                 const float *vertices, GLsizei vertexCount) {
+    if (vertexCount <= 0) {
+        return;
+    }
+    GLint first = (GLint)(streamVertices.size() / 4);
+    streamVertices.insert(streamVertices.end(), vertices, vertices + vertexCount * 4);
+    Submit(key, program, textureID, modelMatrix, 0, vertexCount, first);
+}
+
+// Least significant digit radix sort of the command indices, a byte per
+// pass. It is stable, so equal keys keep their submission order, and passes
+// over bytes every key shares are skipped.
+void RenderQueue::Sort() {
+    size_t count = commands.size();
+    order.resize(count);
+    scratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = (uint32_t)i;
+    }
+    size_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = commands[i].key;
+        for (int pass = 0; pass < 8; pass++) {
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+    for (int pass = 0; pass < 8; pass++) {
+        size_t *histogram = histograms[pass];
+        if (histogram[(commands[0].key >> (pass * 8)) & 0xFF] == count) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t index = order[i];
+            scratch[histogram[(commands[index].key >> (pass * 8)) & 0xFF]++] = index;
+        }
+        order.swap(scratch);
+    }
+}
+
+void RenderQueue::Execute() {
+    programChanges = 0;
+    textureChanges = 0;
+    drawCalls = 0;
+    if (!commands.empty()) {
+        Sort();
+        if (!streamVertices.empty()) {
+            if (streamBuffer == 0) {
+                glGenBuffers(1, &streamBuffer);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+            glBufferData(GL_ARRAY_BUFFER, streamVertices.size() * sizeof(float), streamVertices.data(), GL_STREAM_DRAW);
+        }
+
+        ShaderProgram *program = nullptr;
+        bool textureKnown = false, bufferKnown = false;
+        GLuint texture = 0, buffer = 0;
+        for (uint32_t index : order) {
+            RenderCommand &command = commands[index];
+            if (command.program != program) {
+                if (program != nullptr) {
+                    glDisableVertexAttribArray(program->positionAttribute);
+                    glDisableVertexAttribArray(program->texCoordAttribute);
+                }
+                program = command.program;
+                program->Use();
+                glEnableVertexAttribArray(program->positionAttribute);
+                glEnableVertexAttribArray(program->texCoordAttribute);
+                programChanges++;
+                bufferKnown = false;
+            }
+            if (!textureKnown || command.textureID != texture) {
+                glBindTexture(GL_TEXTURE_2D, command.textureID);
+                texture = command.textureID;
+                textureKnown = true;
+                textureChanges++;
+            }
+            program->SetModelMatrix(command.modelMatrix);
+            GLuint source = command.vertexBuffer != 0 ? command.vertexBuffer : streamBuffer;
+            if (!bufferKnown || source != buffer) {
+                glBindBuffer(GL_ARRAY_BUFFER, source);
+                glVertexAttribPointer(program->positionAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (const void*)0);
+                glVertexAttribPointer(program->texCoordAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (const void*)(2 * sizeof(float)));
+                buffer = source;
+                bufferKnown = true;
+            }
+            glDrawArrays(GL_TRIANGLES, command.firstVertex, command.vertexCount);
+            drawCalls++;
+        }
+        glDisableVertexAttribArray(program->positionAttribute);
+        glDisableVertexAttribArray(program->texCoordAttribute);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    commands.clear();
+    streamVertices.clear();
+}
+
+void RenderQueue::Cleanup() {
+    commands.clear();
+    streamVertices.clear();
+    if (streamBuffer != 0) {
+        glDeleteBuffers(1, &streamBuffer);
+        streamBuffer = 0;
+    }
+}
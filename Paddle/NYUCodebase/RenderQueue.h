@@ -0,0 +1,60 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <vector>
+#include <cstdint>
+#include "ShaderProgram.h"
+#include "glm/mat4x4.hpp"
+
+// Sort key layout, most significant bits first: layer (8), program (8),
+// texture (16), depth (32). Layers give the painter's order; inside a layer
+// commands are grouped by program and then texture so state changes are
+// rare, and depth orders what is left. Commands with equal keys run in the
+// order they were submitted.
+uint64_t RenderSortKey(unsigned int layer, GLuint programID, GLuint textureID, float depth = 0.0f);
+
+// One draw of x, y, u, v triangles.
+struct RenderCommand {
+    uint64_t key;
+    ShaderProgram *program;
+    GLuint textureID;
+    glm::mat4 modelMatrix;
+    // static buffer to draw from, or 0 to draw from the queue's vertex stream
+    GLuint vertexBuffer;
+    GLint firstVertex;
+    GLsizei vertexCount;
+};
+
+// Draw commands submitted during a frame, sorted by key and run together.
+class RenderQueue {
+    public:
+        RenderQueue();
+
+        void Submit(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                    GLuint vertexBuffer, GLsizei vertexCount, GLint firstVertex = 0);
+        // copies the vertices into the queue's stream, which is uploaded in
+        // one piece when the queue executes
+        void SubmitVertices(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                            const float *vertices, GLsizei vertexCount);
+
+        // sorts and runs everything submitted, then empties the queue
+        void Execute();
+        void Cleanup();
+
+        // program binds, texture binds and draw calls made by the last Execute
+        int programChanges;
+        int textureChanges;
+        int drawCalls;
+
+    private:
+        void Sort();
+
+        std::vector<RenderCommand> commands;
+        std::vector<uint32_t> order;        // command indices, sorted by key
+        std::vector<uint32_t> scratch;
+        std::vector<float> streamVertices;
+        GLuint streamBuffer;
+};
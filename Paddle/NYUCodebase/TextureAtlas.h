@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <map>
+
+// Where a region sits in the atlas, in texture coordinates, and its size in pixels.
+struct AtlasRegion {
+    float u, v, width, height;
+    int pixelWidth, pixelHeight;
+};
+
+// The region table Tools/AtlasPacker.cpp writes next to atlas.png. Every
+// image the game draws comes out of that one texture, so all its sprites
+// can batch into a single draw.
+class TextureAtlas {
+    public:
+        TextureAtlas();
+        bool Load(const std::string &tableFile);
+        // asserts when the table has no region of that name
+        const AtlasRegion &Region(const std::string &name) const;
+        // maps a rectangle given in region's own 0-1 coordinates into the atlas
+        static AtlasRegion SubRegion(const AtlasRegion &region, float u, float v, float width, float height);
+
+        unsigned int textureID;     // atlas.png, loaded by the game
+        int width, height;
+        std::map<std::string, AtlasRegion> regions;
+};
@@ -0,0 +1,83 @@
+#include "TextureCache.h"
+#include "stb_image.h"
+#include <iostream>
+#include <cassert>
+
+TextureCache::TextureCache() : hits(0), misses(0), residentBytes(0) {}
+
+GLuint TextureCache::Acquire(const std::string &path) {
+    std::map<std::string, Entry>::iterator found = entries.find(path);
+    if (found != entries.end()) {
+        found->second.references++;
+        hits++;
+        return found->second.textureID;
+    }
+    misses++;
+    int w, h, comp;
+    unsigned char *image = stbi_load(path.c_str(), &w, &h, &comp, STBI_rgb_alpha);
+    if (image == NULL) {
+        std::cout << "Unable to load image " << path << ". Make sure the path is correct\n";
+        assert(false);
+        return 0;
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    stbi_image_free(image);
+
+    Entry entry;
+    entry.textureID = texture;
+    entry.references = 1;
+    entry.bytes = (size_t)w * h * 4;
+    entries[path] = entry;
+    paths[texture] = path;
+    residentBytes += entry.bytes;
+    return texture;
+}
+
+void TextureCache::Release(GLuint textureID) {
+    std::map<GLuint, std::string>::iterator path = paths.find(textureID);
+    if (path == paths.end()) {
+        return;
+    }
+    Entry &entry = entries[path->second];
+    assert(entry.references > 0);
+    if (entry.references > 0) {
+        entry.references--;
+    }
+}
+
+int TextureCache::Purge() {
+    int purged = 0;
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end();) {
+        if (it->second.references == 0) {
+            Delete(it->second);
+            it = entries.erase(it);
+            purged++;
+        } else {
+            ++it;
+        }
+    }
+    return purged;
+}
+
+void TextureCache::Clear() {
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        Delete(it->second);
+    }
+    entries.clear();
+}
+
+void TextureCache::PrintStats() const {
+    std::cout << "Textures: " << entries.size() << " resident (" << residentBytes / 1024 << " KB), "
+              << hits << " hits, " << misses << " misses" << std::endl;
+}
+
+void TextureCache::Delete(const Entry &entry) {
+    glDeleteTextures(1, &entry.textureID);
+    paths.erase(entry.textureID);
+    residentBytes -= entry.bytes;
+}
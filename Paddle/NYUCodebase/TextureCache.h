@@ -0,0 +1,43 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <string>
+#include <map>
+#include <cstddef>
+
+// Textures keyed by the path they were loaded from. Acquiring a path that
+// is already loaded returns the same texture instead of decoding the image
+// again. Every Acquire takes a reference that Release hands back, and
+// Purge deletes the textures nobody holds any more.
+class TextureCache {
+    public:
+        TextureCache();
+
+        // asserts when the image can't be loaded
+        GLuint Acquire(const std::string &path);
+        void Release(GLuint textureID);
+        // deletes every texture with no references left and returns how many
+        int Purge();
+        // deletes every texture, held or not
+        void Clear();
+        // hits, misses and resident textures, written to std::cout
+        void PrintStats() const;
+
+        int hits;
+        int misses;
+        size_t residentBytes;      // RGBA8 bytes of every loaded texture
+
+    private:
+        struct Entry {
+            GLuint textureID;
+            int references;
+            size_t bytes;
+        };
+        void Delete(const Entry &entry);
+
+        std::map<std::string, Entry> entries;
+        std::map<GLuint, std::string> paths;
+};
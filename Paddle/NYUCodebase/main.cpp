@@ -15,6 +15,14 @@
 
 //import the shader program
 #include "ShaderProgram.h"
+//draw every sprite of a texture in one call
+#include "SpriteBatch.h"
+//sort each frame's draws to keep state changes down
+#include "RenderQueue.h"
+//the paddles and the ball, packed into atlas.png
+#include "TextureAtlas.h"
+//one texture per image path, however often it is loaded
+#include "TextureCache.h"
 //import the matrix class
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -26,14 +34,17 @@
 SDL_Window* displayWindow;
 ShaderProgram textured_program;
 ShaderProgram untextured_program;
-GLuint playerTexture;
-GLuint enemyTexture;
-GLuint ballTexture;
+SpriteBatch sprite_batch;
+RenderQueue render_queue;
+//render queue layers, drawn back to front
+enum RenderLayer {RENDER_SPRITES};
+//every texture the game has loaded
+TextureCache texture_cache;
+//atlas.png holds every entity's image, so all of them draw in one call
+TextureAtlas atlas;
 //GLuint lineTexture;
 
 
-float vertices[] = {-0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5};
-float texCoords[] = {0.0, 1.0, 1.0, 1.0, 1.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0, 0.0};
 float lastFrameTicks = 0.0f;
 
 const float SCREEN_WIDTH = 1280.0;
@@ -51,12 +62,13 @@ const float PI = atan(1.0)*4;
 
 class Entity {
 public:
-    void Draw(ShaderProgram &p) {
+    void Draw(SpriteBatch &batch) {
         //order matters. translate then scale entities
         glm::mat4 newMatrix = glm::mat4(1.0f);
         newMatrix = glm::translate(newMatrix, glm::vec3(x, y, 1.0f));
         newMatrix = glm::scale(newMatrix, glm::vec3(x_scale, y_scale, 1.0f));
-        p.SetModelMatrix(newMatrix);
+        //each entity shows its region of the atlas
+        batch.Draw(textureID, newMatrix, region.u, region.v, region.width, region.height);
     }
     float x;
     float y;
@@ -65,6 +77,7 @@ public:
     float rotation;
     
     int textureID;
+    AtlasRegion region;
     
     float width;
     float height;
@@ -79,25 +92,6 @@ Entity playerPaddle;
 Entity enemyPaddle;
 Entity ball;
 
-//function to load textures
-GLuint LoadTexture(const char *filePath) {
-    int w,h,comp;
-    unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-    if(image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
-    }
-    GLuint retTexture;
-    glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    stbi_image_free(image);
-    
-    return retTexture;
-}
-
 void Setup() {
     // setup SDL
     // setup OpenGL
@@ -129,7 +123,7 @@ void Setup() {
     glm::mat4 viewMatrix = glm::mat4(1.0f);
     
     //use set the view and projection matrix to shader
-    glUseProgram(textured_program.programID);
+    textured_program.Use();
     textured_program.SetProjectionMatrix(projectionMatrix);
     textured_program.SetViewMatrix(viewMatrix);
     
@@ -138,10 +132,6 @@ void Setup() {
     //set alpha blend function
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
-    //set attributes for shaders
-    glVertexAttribPointer(textured_program.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-    glVertexAttribPointer(textured_program.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-    
     //setup Matrix for player's paddle (Right side)
     //set width and height of player's paddle. Initial height can be hardcoded to 1
     playerPaddle.height = 1;
@@ -177,11 +167,16 @@ void Setup() {
     //setup Matrix for middle separating line
     //modelMatrixLine = glm::scale(modelMatrixLine, glm::vec3(1.0f, 2.0f, 1.0f));
     
-    //load the textures for all entities
-    playerTexture = LoadTexture(RESOURCE_FOLDER"player.png");
-    enemyTexture = LoadTexture(RESOURCE_FOLDER"enemy.png");
-    ballTexture = LoadTexture(RESOURCE_FOLDER"ball.png");
-    //lineTexture = LoadTexture(RESOURCE_FOLDER"line.png");
+    //load the atlas for all entities
+    atlas.Load(RESOURCE_FOLDER"atlas.txt");
+    atlas.textureID = texture_cache.Acquire(RESOURCE_FOLDER"atlas.png");
+    playerPaddle.textureID = atlas.textureID;
+    playerPaddle.region = atlas.Region("player");
+    enemyPaddle.textureID = atlas.textureID;
+    enemyPaddle.region = atlas.Region("enemy");
+    ball.textureID = atlas.textureID;
+    ball.region = atlas.Region("ball");
+    //lineTexture = texture_cache.Acquire(RESOURCE_FOLDER"line.png");
     
 }
 
@@ -293,26 +288,18 @@ void Render() {
     // for all game elements
     // setup transforms, render sprites
     
-    glEnableVertexAttribArray(textured_program.positionAttribute);
-    glEnableVertexAttribArray(textured_program.texCoordAttribute);
-    
     //draw the player paddle
-    playerPaddle.Draw(textured_program);
-    glBindTexture(GL_TEXTURE_2D, playerTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    playerPaddle.Draw(sprite_batch);
     
     //draw the enemy paddle
-    enemyPaddle.Draw(textured_program);
-    glBindTexture(GL_TEXTURE_2D, enemyTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    enemyPaddle.Draw(sprite_batch);
     
     //draw the ball
-    ball.Draw(textured_program);
-    glBindTexture(GL_TEXTURE_2D, ballTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    ball.Draw(sprite_batch);
     
-    glDisableVertexAttribArray(textured_program.positionAttribute);
-    glDisableVertexAttribArray(textured_program.texCoordAttribute);
+    //one draw call per texture, sorted by the render queue
+    sprite_batch.Submit(render_queue, textured_program, RENDER_SPRITES);
+    render_queue.Execute();
 
 }
 
@@ -326,7 +313,13 @@ int main(int argc, char *argv[])
         Update();
         Render();
         SDL_GL_SwapWindow(displayWindow);
+        ShaderProgram::ResetCounters();     //fold the frame's skipped calls into the totals printed at exit
     }
+    sprite_batch.Cleanup();
+    render_queue.Cleanup();
+    texture_cache.PrintStats();
+    ShaderProgram::PrintCounters();
+    texture_cache.Clear();
     SDL_Quit();
     return 0;
 }
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Cooked texture (.tex) layout, written by Tools/TextureCooker.cpp next to
+// the PNG it was cooked from. A fixed header is followed by RGBA8 texels,
+// top row first, one mip level after another from the full size down, so
+// the loader can map the file and hand each level straight to the GPU
+// without decoding anything.
+const char COOKED_TEXTURE_MAGIC[4] = {'C', 'T', 'E', 'X'};
+const uint32_t COOKED_TEXTURE_VERSION = 2;
+
+struct CookedTextureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;        // mip levels stored, 1 when only the full size image is
+    uint32_t sourceSize;    // byte size of the PNG it was cooked from, to spot a stale file
+    uint32_t sourceHash;    // CookedSourceHash of that PNG, for edits that keep its size
+    uint32_t dataOffset;    // first level's texels
+    uint32_t fileSize;
+};
+
+// 32-bit FNV-1a hash of the source PNG's bytes
+inline uint32_t CookedSourceHash(const unsigned char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// width or height of a mip level, halved per level and never below 1
+inline uint32_t CookedLevelSize(uint32_t size, uint32_t level) {
+    return (size >> level) > 0 ? size >> level : 1;
+}
+
+// bytes of every level from 0 up to, but not including, levels
+inline size_t CookedTexelBytes(uint32_t width, uint32_t height, uint32_t levels) {
+    size_t bytes = 0;
+    for (uint32_t level = 0; level < levels; level++) {
+        bytes += (size_t)CookedLevelSize(width, level) * CookedLevelSize(height, level) * 4;
+    }
+    return bytes;
+}
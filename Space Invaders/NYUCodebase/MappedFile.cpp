@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+#ifdef _WINDOWS
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+	data = nullptr;
+	size = 0;
+#ifdef _WINDOWS
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WINDOWS
+
+bool MappedFile::Open(const std::string &fileName) {
+	Close();
+	fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return false;
+	}
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mappingHandle == nullptr) {
+		Close();
+		return false;
+	}
+	data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if(data == nullptr) {
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if(data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+	if(mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+	}
+	if(fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+	}
+	data = nullptr;
+	size = 0;
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string &fileName) {
+	Close();
+	fileDescriptor = open(fileName.c_str(), O_RDONLY);
+	if(fileDescriptor < 0) {
+		return false;
+	}
+	struct stat fileInfo;
+	if(fstat(fileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0) {
+		Close();
+		return false;
+	}
+	void *mapping = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if(mapping == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	data = (const unsigned char*)mapping;
+	size = (size_t)fileInfo.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if(data != nullptr) {
+		munmap((void*)data, size);
+	}
+	if(fileDescriptor >= 0) {
+		close(fileDescriptor);
+	}
+	data = nullptr;
+	size = 0;
+	fileDescriptor = -1;
+}
+
+#endif
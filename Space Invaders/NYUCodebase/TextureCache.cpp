@@ -0,0 +1,170 @@
+#include "TextureCache.h"
+#include "CookedTexture.h"
+#include "MappedFile.h"
+#include "stb_image.h"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+
+namespace {
+
+// false when a cooked texture's header doesn't match the PNG at sourceName;
+// a missing PNG matches anything, since the .tex can ship without it
+bool Source_Matches(const CookedTextureHeader &header, const std::string &sourceName) {
+    MappedFile source;
+    if (!source.Open(sourceName)) {
+        return true;
+    }
+    return header.sourceSize == (uint32_t)source.size &&
+        header.sourceHash == CookedSourceHash(source.data, source.size);
+}
+
+// rgba holds levels mip levels back to back, largest first
+GLuint Upload(const unsigned char *rgba, int width, int height, int levels) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int level = 0; level < levels; level++) {
+        int levelWidth = CookedLevelSize(width, level), levelHeight = CookedLevelSize(height, level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        rgba += (size_t)levelWidth * levelHeight * 4;
+    }
+    if (levels > 1) {
+        // the chain may stop short of 1x1, so tell GL where it ends
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+// the .tex a PNG is cooked into, or an empty string for any other file
+std::string Cooked_Name(const std::string &path) {
+    const std::string png = ".png";
+    if (path.size() < png.size() || path.compare(path.size() - png.size(), png.size(), png) != 0) {
+        return std::string();
+    }
+    return path.substr(0, path.size() - png.size()) + ".tex";
+}
+
+}
+
+TextureCache::TextureCache() : hits(0), misses(0), cookedLoads(0), residentBytes(0), loadMilliseconds(0.0) {}
+
+GLuint TextureCache::Acquire(const std::string &path) {
+    std::map<std::string, Entry>::iterator found = entries.find(path);
+    if (found != entries.end()) {
+        found->second.references++;
+        hits++;
+        return found->second.textureID;
+    }
+    misses++;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    GLuint texture = 0;
+    std::string cooked = Cooked_Name(path);
+    if (!cooked.empty()) {
+        texture = LoadCooked(cooked, path, &bytes);
+    }
+    if (texture != 0) {
+        cookedLoads++;
+    } else {
+        texture = LoadPNG(path, &bytes);
+        if (texture == 0) {
+            std::cout << "Unable to load image " << path << ". Make sure the path is correct\n";
+            assert(false);
+            return 0;
+        }
+    }
+    loadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    Entry entry;
+    entry.textureID = texture;
+    entry.references = 1;
+    entry.bytes = bytes;
+    entries[path] = entry;
+    paths[texture] = path;
+    residentBytes += entry.bytes;
+    return texture;
+}
+
+void TextureCache::Release(GLuint textureID) {
+    std::map<GLuint, std::string>::iterator path = paths.find(textureID);
+    if (path == paths.end()) {
+        return;
+    }
+    Entry &entry = entries[path->second];
+    assert(entry.references > 0);
+    if (entry.references > 0) {
+        entry.references--;
+    }
+}
+
+int TextureCache::Purge() {
+    int purged = 0;
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end();) {
+        if (it->second.references == 0) {
+            Delete(it->second);
+            it = entries.erase(it);
+            purged++;
+        } else {
+            ++it;
+        }
+    }
+    return purged;
+}
+
+void TextureCache::Clear() {
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        Delete(it->second);
+    }
+    entries.clear();
+}
+
+void TextureCache::PrintStats() const {
+    std::cout << "Textures: " << entries.size() << " resident (" << residentBytes / 1024 << " KB), "
+              << hits << " hits, " << misses << " misses (" << cookedLoads << " cooked), "
+              << loadMilliseconds << " ms loading" << std::endl;
+}
+
+GLuint TextureCache::LoadPNG(const std::string &fileName, size_t *bytes) {
+    int w, h, comp;
+    unsigned char *image = stbi_load(fileName.c_str(), &w, &h, &comp, STBI_rgb_alpha);
+    if (image == NULL) {
+        return 0;
+    }
+    GLuint texture = Upload(image, w, h, 1);
+    stbi_image_free(image);
+    *bytes = (size_t)w * h * 4;
+    return texture;
+}
+
+GLuint TextureCache::LoadCooked(const std::string &fileName, const std::string &sourceName, size_t *bytes) {
+    MappedFile file;
+    if (!file.Open(fileName) || file.size < sizeof(CookedTextureHeader)) {
+        return 0;
+    }
+    const CookedTextureHeader *header = (const CookedTextureHeader*)file.data;
+    bool valid = memcmp(header->magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC)) == 0 &&
+        header->version == COOKED_TEXTURE_VERSION &&
+        header->fileSize == file.size &&
+        header->width > 0 && header->height > 0 &&
+        header->levels > 0 && header->levels <= 32 &&
+        header->dataOffset + CookedTexelBytes(header->width, header->height, header->levels) <= file.size &&
+        Source_Matches(*header, sourceName);
+    if (!valid) {
+        return 0;   // stale or foreign file, the caller falls back to the PNG
+    }
+    // the texels are uploaded straight out of the mapping
+    *bytes = CookedTexelBytes(header->width, header->height, header->levels);
+    return Upload(file.data + header->dataOffset, header->width, header->height, header->levels);
+}
+
+void TextureCache::Delete(const Entry &entry) {
+    glDeleteTextures(1, &entry.textureID);
+    paths.erase(entry.textureID);
+    residentBytes -= entry.bytes;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <string>
+#include <map>
+#include <cstddef>
+
+// Textures keyed by the path they were loaded from. Acquiring a path that
+// is already loaded returns the same texture instead of decoding the image
+// again. Every Acquire takes a reference that Release hands back, and
+// Purge deletes the textures nobody holds any more. A PNG with an up to
+// date cooked .tex next to it (see CookedTexture.h) is loaded from that
+// instead, skipping the decode.
+class TextureCache {
+    public:
+        TextureCache();
+
+        // asserts when the image can't be loaded
+        GLuint Acquire(const std::string &path);
+        void Release(GLuint textureID);
+        // deletes every texture with no references left and returns how many
+        int Purge();
+        // deletes every texture, held or not
+        void Clear();
+        // hits, misses and resident textures, written to std::cout
+        void PrintStats() const;
+
+        int hits;
+        int misses;
+        int cookedLoads;            // misses served from a .tex
+        size_t residentBytes;       // RGBA8 bytes of every loaded texture, mip levels included
+        double loadMilliseconds;    // time spent loading on misses
+
+    private:
+        struct Entry {
+            GLuint textureID;
+            int references;
+            size_t bytes;
+        };
+        // both return 0 when the file can't be used and set bytes otherwise
+        GLuint LoadPNG(const std::string &fileName, size_t *bytes);
+        // a cooked file is only used while it matches the PNG at sourceName
+        GLuint LoadCooked(const std::string &fileName, const std::string &sourceName, size_t *bytes);
+        void Delete(const Entry &entry);
+
+        std::map<std::string, Entry> entries;
+        std::map<GLuint, std::string> paths;
+};
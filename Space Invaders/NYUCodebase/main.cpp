@@ -13,6 +13,10 @@
 #endif
 
 #include "ShaderProgram.h"  //import the shader program
+#include "SpriteBatch.h"    //draw every sprite of a texture in one call
+#include "RenderQueue.h"    //sort each frame's draws to keep state changes down
+#include "TextureAtlas.h"   //every image the game draws, packed into atlas.png
+#include "TextureCache.h"   //one texture per image path, however often it is loaded
 #include "glm/mat4x4.hpp"   //import the matrix class
 #include "glm/gtc/matrix_transform.hpp"
 #define STB_IMAGE_IMPLEMENTATION
@@ -25,6 +29,13 @@
 SDL_Window* displayWindow;
 ShaderProgram textured_program;
 ShaderProgram untextured_program;
+SpriteBatch sprite_batch;
+RenderQueue render_queue;   //everything drawn in a frame is submitted here and runs sorted at the end of Render
+enum RenderLayer {RENDER_SPRITES, RENDER_UI};     //render queue layers, drawn back to front
+TextureCache texture_cache;     //every texture the game has loaded
+TextureAtlas atlas;     //atlas.png, loaded once and shared by every ship, laser and glyph so they batch together
+//sprite sizes are measured in sheet.png's units, pixels / 1024, the units the game was tuned in
+const float SHEET_PIXELS = 1024.0f;
 //float vertices[] = {-0.5, -0.5, 0.5, -0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5};
 //float texCoords[] = {0.0, 1.0, 1.0, 1.0, 1.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0, 0.0};
 float lastFrameTicks = 0.0f;
@@ -35,24 +46,6 @@ const float SCREEN_HEIGHT = 720.0;
 //************************************
 
 
-//function to load textures
-GLuint LoadTexture(const char *filePath) {
-    int w,h,comp;
-    unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-    if(image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
-    }
-    GLuint retTexture;
-    glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    stbi_image_free(image);
-    return retTexture;
-}
-
 
 //************************************
 //Game class definitions begin here
@@ -60,53 +53,27 @@ GLuint LoadTexture(const char *filePath) {
 class SheetSprite {
 public:
     SheetSprite() {}
-    SheetSprite(unsigned int textureID, float u, float v, float width, float height, float x, float y, float x_scale, float y_scale) {
+    SheetSprite(unsigned int textureID, const AtlasRegion& region, float x, float y, float x_scale, float y_scale) {
         this->textureID = textureID;
-        this->u = u;
-        this->v = v;
-        this->width = width;
-        this->height = height;
+        this->region = region;
+        this->width = region.pixelWidth / SHEET_PIXELS;
+        this->height = region.pixelHeight / SHEET_PIXELS;
         this->x = x;
         this->y = y;
         this->x_scale = x_scale;
         this->y_scale = y_scale;
     }
-    void Draw(ShaderProgram &p) {
+    void Draw(SpriteBatch &batch) {
         glm::mat4 newMatrix = glm::mat4(1.0f);
         newMatrix = glm::translate(newMatrix, glm::vec3(x, y, 1.0f));
         newMatrix = glm::scale(newMatrix, glm::vec3(x_scale, y_scale, 1.0f));
-        p.SetModelMatrix(newMatrix);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        GLfloat texCoords[] = {
-            u, v+height,
-            u+width, v,
-            u, v,
-            u+width, v,
-            u, v+height,
-            u+width, v+height
-        };
         float aspect = width / height;
-        float vertices[] = {
-            -0.5f * aspect, -0.5f,
-            0.5f * aspect, 0.5f,
-            -0.5f * aspect, 0.5f,
-            0.5f * aspect, 0.5f,
-            -0.5f * aspect, -0.5f,
-            0.5f * aspect, -0.5f
-        };
-        glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-        glEnableVertexAttribArray(p.positionAttribute);
-        glEnableVertexAttribArray(p.texCoordAttribute);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDisableVertexAttribArray(p.positionAttribute);
-        glDisableVertexAttribArray(p.texCoordAttribute);
+        batch.Draw(textureID, newMatrix, region.u, region.v, region.width, region.height, 0.5f * aspect, 0.5f);
     }
     float x_scale;
     float y_scale;
     unsigned int textureID;
-    float u;
-    float v;
+    AtlasRegion region;     //where the image sits in the atlas
     float width;
     float height;
     float x;
@@ -140,17 +107,13 @@ enum GameMode {TITLE_SCREEN, GAME_LEVEL};
 //************************************
 void shoot_laser(GameState& state) {
     Entity laser;
-    float u = 843.0f/1024.0f;
-    float v = 602.0f/1024.0f;
-    float width = 13.0f/1024.0f;
-    float height = 37.0f/1024.0f;
     float x_scale = 0.05f;
     float y_scale = 0.20f;
     //X coordinate will be the player's ship
     float x = state.playerShip[0].sprite.x;
     //Y coordinate will be at the tip of the player's ship
     float y = state.playerShip[0].sprite.y + state.playerShip[0].sprite.height*2;
-    laser.sprite = SheetSprite(LoadTexture(RESOURCE_FOLDER"sheet.png"), u, v, width, height, x, y, x_scale, y_scale);
+    laser.sprite = SheetSprite(atlas.textureID, atlas.Region("laser"), x, y, x_scale, y_scale);
     laser.y_velocity = 2.0f;
     state.lasers.push_back(laser);
 }
@@ -322,18 +285,21 @@ void Render_Game_Level(GameState& state) {
     
     //draw the player ship
     for (Entity& ship: state.playerShip) {
-        ship.sprite.Draw(textured_program);
+        ship.sprite.Draw(sprite_batch);
     }
 
     //draw the enemy ship
     for (Entity& ship: state.enemyShips) {
-        ship.sprite.Draw(textured_program);
+        ship.sprite.Draw(sprite_batch);
     }
     
     //draw the lasers
     for (Entity& laser: state.lasers) {
-        laser.sprite.Draw(textured_program);
+        laser.sprite.Draw(sprite_batch);
     }
+    
+    //ships and lasers all come from the sprite sheet, so they go out in one draw call
+    sprite_batch.Submit(render_queue, textured_program, RENDER_SPRITES);
 
 }
 //************************************
@@ -344,55 +310,36 @@ void Render_Game_Level(GameState& state) {
 //************************************
 //Overall GameMode Title_Screen methods begin here
 //************************************
-void DrawText(ShaderProgram &p, int fontTexture, std::string text, float size, float spacing, float x, float y) {
+//font is the 16x16 glyph grid's region of the texture
+void DrawText(ShaderProgram &p, int fontTexture, const AtlasRegion &font, std::string text, float size, float spacing, float x, float y) {
     glm::mat4 newMatrix = glm::mat4(1.0f);
     newMatrix = glm::translate(newMatrix, glm::vec3(x, y, 1.0f));
-    p.SetModelMatrix(newMatrix);
     
-    float character_size = 1.0/16.0f;
+    float character_width = font.width/16.0f;
+    float character_height = font.height/16.0f;
     std::vector<float> vertexData;
-    std::vector<float> texCoordData;
     for(int i=0; i < text.size(); i++) {
-        int spriteIndex = (int)text[i];
-        //std::cout << "This is the letter " << text[i] << std::endl;
-        //std::cout << "This is the sprite index " << spriteIndex << std::endl;
-        float texture_x = (float)(spriteIndex % 16) / 16.0f;
-        float texture_y = (float)(spriteIndex / 16) / 16.0f;
-        //std::cout << "This texture_x " << texture_x << std::endl;
-        //std::cout << "This texture_y " << texture_y << std::endl;
+        int spriteIndex = (unsigned char)text[i];
+        float texture_x = font.u + (float)(spriteIndex % 16) * character_width;
+        float texture_y = font.v + (float)(spriteIndex / 16) * character_height;
+        //x, y, u, v for each vertex
         vertexData.insert(vertexData.end(), {
-            ((size+spacing) * i) + (-0.5f * size), 0.5f * size,
-            ((size+spacing) * i) + (-0.5f * size), -0.5f * size,
-            ((size+spacing) * i) + (0.5f * size), 0.5f * size,
-            ((size+spacing) * i) + (0.5f * size), -0.5f * size,
-            ((size+spacing) * i) + (0.5f * size), 0.5f * size,
-            ((size+spacing) * i) + (-0.5f * size), -0.5f * size,
+            ((size+spacing) * i) + (-0.5f * size), 0.5f * size, texture_x, texture_y,
+            ((size+spacing) * i) + (-0.5f * size), -0.5f * size, texture_x, texture_y + character_height,
+            ((size+spacing) * i) + (0.5f * size), 0.5f * size, texture_x + character_width, texture_y,
+            ((size+spacing) * i) + (0.5f * size), -0.5f * size, texture_x + character_width, texture_y + character_height,
+            ((size+spacing) * i) + (0.5f * size), 0.5f * size, texture_x + character_width, texture_y,
+            ((size+spacing) * i) + (-0.5f * size), -0.5f * size, texture_x, texture_y + character_height,
         });
-        texCoordData.insert(texCoordData.end(), {
-            texture_x, texture_y,
-            texture_x, texture_y + character_size,
-            texture_x + character_size, texture_y,
-            texture_x + character_size, texture_y + character_size,
-            texture_x + character_size, texture_y,
-            texture_x, texture_y + character_size,
-        }); }
-    glBindTexture(GL_TEXTURE_2D, fontTexture);
-    // draw this data (use the .data() method of std::vector to get pointer to data)
-    glEnableVertexAttribArray(p.positionAttribute);
-    glEnableVertexAttribArray(p.texCoordAttribute);
-    glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertexData.data());
-    glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoordData.data());
-    glDrawArrays(GL_TRIANGLES, 0, 6*text.size() );
-    //std::cout << "This is the array vertices number " << (6*text.size()) << std::endl;
-    // draw this yourself, use text.size() * 6 or vertexData.size()/2 to get number of vertices
-    glDisableVertexAttribArray(p.positionAttribute);
-    glDisableVertexAttribArray(p.texCoordAttribute);
+    }
+    //the queue copies the vertices, so they can go out of scope before it draws
+    render_queue.SubmitVertices(RenderSortKey(RENDER_UI, p.programID, fontTexture), p, fontTexture, newMatrix, vertexData.data(), vertexData.size() / 4);
 }
 void Render_Title_Screen() {
-    DrawText(textured_program, LoadTexture(RESOURCE_FOLDER"font1.png"), "Welcome to Space Invaders", 0.14f, -0.05f, -1.1f, 0.5f);
-    DrawText(textured_program, LoadTexture(RESOURCE_FOLDER"font1.png"), "Press enter to play", 0.1f, -0.05f, -0.5f, 0.0f);
-    DrawText(textured_program, LoadTexture(RESOURCE_FOLDER"font1.png"), "Left/right arrow keys to move", 0.1f, -0.05f, -0.75f, -0.4f);
-    DrawText(textured_program, LoadTexture(RESOURCE_FOLDER"font1.png"), "Spacebar to shoot", 0.1f, -0.05f, -0.45, -0.6f);
+    DrawText(textured_program, atlas.textureID, atlas.Region("font"), "Welcome to Space Invaders", 0.14f, -0.05f, -1.1f, 0.5f);
+    DrawText(textured_program, atlas.textureID, atlas.Region("font"), "Press enter to play", 0.1f, -0.05f, -0.5f, 0.0f);
+    DrawText(textured_program, atlas.textureID, atlas.Region("font"), "Left/right arrow keys to move", 0.1f, -0.05f, -0.75f, -0.4f);
+    DrawText(textured_program, atlas.textureID, atlas.Region("font"), "Spacebar to shoot", 0.1f, -0.05f, -0.45, -0.6f);
 }
 void Update_Title_Screen() {
     
@@ -446,25 +393,25 @@ void Setup(GameState& state) {
     glm::mat4 viewMatrix = glm::mat4(1.0f);
     
     //use set the view and projection matrix to shader
-    glUseProgram(textured_program.programID);
+    textured_program.Use();
     textured_program.SetProjectionMatrix(projectionMatrix);
     textured_program.SetViewMatrix(viewMatrix);
     glEnable(GL_BLEND); //enable blending
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  //set alpha blend function
+    atlas.Load(RESOURCE_FOLDER"atlas.txt");
+    atlas.textureID = texture_cache.Acquire(RESOURCE_FOLDER"atlas.png");
     
     //setup player ship
     for (int i = 0; i < 1; i++) {
         Entity player;
-        float u = 346.0f/1024.0f;
-        float v = 75.0f/1024.0f;
-        float width = 98.0f/1024.0f;
-        float height = 75.0f/1024.0f;
+        const AtlasRegion& region = atlas.Region("player");
+        float height = region.pixelHeight / SHEET_PIXELS;
         float x_scale = 0.2f;
         float y_scale = 0.2f;
         float x = 0.0f;
         //the Y coordinate will be at the bottom of the screen
         float y = -1.0 + height*2;
-        player.sprite = SheetSprite(LoadTexture(RESOURCE_FOLDER"sheet.png"), u, v, width, height, x, y, x_scale, y_scale);
+        player.sprite = SheetSprite(atlas.textureID, region, x, y, x_scale, y_scale);
         //player.x_velocity = 1.5f;
         state.playerShip.push_back(player);
     }
@@ -474,17 +421,16 @@ void Setup(GameState& state) {
     const int ENEMIES_PER_LINE = 7;
     for (int i = 0; i < NUMBER_OF_ENEMY_SHIPS; i++) {
         Entity enemyShip;
-        float u = 120.0f/1024.0f;
-        float v = 520.0f/1024.0f;
-        float width = 104.0f/1024.0f;
-        float height = 84.0f/1024.0f;
+        const AtlasRegion& region = atlas.Region("enemy");
+        float width = region.pixelWidth / SHEET_PIXELS;
+        float height = region.pixelHeight / SHEET_PIXELS;
         float x_scale = 0.15f;
         float y_scale = 0.15f;
         //the X coordinate will be 2 times the width of each ship spaced apart
         float x = 1.777 - (width * 2) * (1 + (i % ENEMIES_PER_LINE));
         //the Y coordinate will be two times the height of each ship spaced apart
         float y = 1.0 - (i % (NUMBER_OF_ENEMY_SHIPS/ENEMIES_PER_LINE) * height * 2) - height;
-        enemyShip.sprite = SheetSprite(LoadTexture(RESOURCE_FOLDER"sheet.png"),u ,v , width, height, x, y, x_scale, y_scale);
+        enemyShip.sprite = SheetSprite(atlas.textureID, region, x, y, x_scale, y_scale);
         //move -X and -Y direction at the start
         enemyShip.x_velocity = -0.5f;
         enemyShip.y_velocity = -height * 3.0;
@@ -500,6 +446,8 @@ void Render(GameState& state, GameMode& mode) {
             Render_Game_Level(state);
             break;
     }
+    //everything above was only queued; sort it by layer and state and draw it
+    render_queue.Execute();
 }
 void Update(GameState& state, GameMode& mode) {
     switch(mode) {
@@ -538,7 +486,13 @@ int main(int argc, char *argv[])
         Update(state, mode);
         Render(state, mode);
         SDL_GL_SwapWindow(displayWindow);
+        ShaderProgram::ResetCounters();     //fold the frame's skipped calls into the totals printed at exit
     }
+    sprite_batch.Cleanup();
+    render_queue.Cleanup();
+    texture_cache.PrintStats();
+    ShaderProgram::PrintCounters();
+    texture_cache.Clear();
     SDL_Quit();
     return 0;
 }
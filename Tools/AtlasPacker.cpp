@@ -0,0 +1,193 @@
+//************************************
+//Atlas packer: merges a game's images into one texture atlas and writes the
+//region table TextureAtlas::Load reads at startup, so every sprite can share
+//one texture and batch into a single draw.
+//
+//The source list has one "name image [x y width height]" line per region,
+//with image paths relative to the list. The optional rectangle cuts the
+//region out of a larger sheet; without it the whole image is used. Lines
+//starting with # are comments.
+//
+//Build (from this folder):
+//  clang++ -std=c++11 -O2 -I"../Ultimate 2D Adventure - Final Project/NYUCodebase" AtlasPacker.cpp "../Ultimate 2D Adventure - Final Project/NYUCodebase/PNGWriter.cpp" -lz -o atlaspack
+//Usage:
+//  ./atlaspack ../Paddle/NYUCodebase/AtlasSources.txt ../Paddle/NYUCodebase/atlas
+//which writes atlas.png and atlas.txt next to the game's other resources.
+//************************************
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "PNGWriter.h"
+
+//empty texels left around every region. The region's border texels are copied
+//into it, so linear filtering at a region's edge never reads its neighbour.
+const int PADDING = 2;
+
+struct Region {
+    std::string name;
+    int width = 0, height = 0;
+    std::vector<unsigned char> pixels;     //RGBA, top row first
+    int x = 0, y = 0;                      //where the region landed in the atlas, padding excluded
+};
+
+std::string Folder_Of(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+//reads the source list and cuts every region out of its image
+bool Load_Regions(const std::string& fileName, std::vector<Region>& regions) {
+    std::ifstream infile(fileName);
+    if (!infile) {
+        std::cout << "Unable to read " << fileName << std::endl;
+        return false;
+    }
+    std::string folder = Folder_Of(fileName);
+    std::string line;
+    while (std::getline(infile, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream lineStream(line);
+        std::string name, image;
+        if (!(lineStream >> name >> image)) {
+            continue;
+        }
+        int w, h, comp;
+        unsigned char *data = stbi_load((folder + image).c_str(), &w, &h, &comp, STBI_rgb_alpha);
+        if (data == NULL) {
+            std::cout << "Unable to load " << folder + image << std::endl;
+            return false;
+        }
+        int cutX = 0, cutY = 0, cutWidth = w, cutHeight = h;
+        if (lineStream >> cutX >> cutY >> cutWidth >> cutHeight) {
+            if (cutX < 0 || cutY < 0 || cutWidth <= 0 || cutHeight <= 0 || cutX + cutWidth > w || cutY + cutHeight > h) {
+                std::cout << "Region " << name << " falls outside " << image << std::endl;
+                stbi_image_free(data);
+                return false;
+            }
+        }
+        Region region;
+        region.name = name;
+        region.width = cutWidth;
+        region.height = cutHeight;
+        region.pixels.resize(cutWidth * cutHeight * 4);
+        for (int row = 0; row < cutHeight; row++) {
+            memcpy(&region.pixels[row * cutWidth * 4], data + ((cutY + row) * w + cutX) * 4, cutWidth * 4);
+        }
+        stbi_image_free(data);
+        regions.push_back(region);
+    }
+    return !regions.empty();
+}
+
+//Input: regions sorted tallest first, atlas width
+//places the regions left to right in shelves as tall as their first region and returns the height used
+int Pack_Shelves(std::vector<Region>& regions, int atlasWidth) {
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+    for (Region& region : regions) {
+        int paddedWidth = region.width + PADDING * 2, paddedHeight = region.height + PADDING * 2;
+        if (shelfX + paddedWidth > atlasWidth) {
+            shelfY += shelfHeight;
+            shelfX = 0;
+            shelfHeight = 0;
+        }
+        region.x = shelfX + PADDING;
+        region.y = shelfY + PADDING;
+        shelfX += paddedWidth;
+        shelfHeight = std::max(shelfHeight, paddedHeight);
+    }
+    return shelfY + shelfHeight;
+}
+
+//tries every width from the widest region to all regions in one row and keeps the smallest atlas
+void Pack(std::vector<Region>& regions, int& atlasWidth, int& atlasHeight) {
+    std::stable_sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.height > b.height; });
+    int widest = 0, total = 0;
+    for (const Region& region : regions) {
+        widest = std::max(widest, region.width + PADDING * 2);
+        total += region.width + PADDING * 2;
+    }
+    long bestArea = -1;
+    for (int width = widest; width <= total; width++) {
+        int height = Pack_Shelves(regions, width);
+        long area = (long)width * height;
+        //prefer the squarer atlas when two are the same size
+        if (bestArea < 0 || area < bestArea || (area == bestArea && std::abs(width - height) < std::abs(atlasWidth - atlasHeight))) {
+            bestArea = area;
+            atlasWidth = width;
+            atlasHeight = height;
+        }
+    }
+    Pack_Shelves(regions, atlasWidth);
+}
+
+//copies the regions into the atlas and extrudes their borders into the padding
+std::vector<unsigned char> Compose(const std::vector<Region>& regions, int atlasWidth, int atlasHeight) {
+    std::vector<unsigned char> atlas(atlasWidth * atlasHeight * 4, 0);
+    for (const Region& region : regions) {
+        for (int y = -PADDING; y < region.height + PADDING; y++) {
+            int sourceY = std::min(std::max(y, 0), region.height - 1);
+            for (int x = -PADDING; x < region.width + PADDING; x++) {
+                int sourceX = std::min(std::max(x, 0), region.width - 1);
+                memcpy(&atlas[((region.y + y) * atlasWidth + region.x + x) * 4], &region.pixels[(sourceY * region.width + sourceX) * 4], 4);
+            }
+        }
+    }
+    return atlas;
+}
+
+//the table TextureAtlas::Load reads: the atlas size, then each region's pixel rectangle
+bool Write_Table(const std::string& fileName, const std::string& sources, const std::vector<Region>& regions, int atlasWidth, int atlasHeight) {
+    std::ofstream out(fileName);
+    if (!out) {
+        return false;
+    }
+    out << "# Generated by Tools/AtlasPacker.cpp from " << sources << ". Edit that file and rerun the packer instead." << std::endl;
+    out << "size " << atlasWidth << " " << atlasHeight << std::endl;
+    for (const Region& region : regions) {
+        out << region.name << " " << region.x << " " << region.y << " " << region.width << " " << region.height << std::endl;
+    }
+    return (bool)out;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        std::cout << "usage: " << argv[0] << " <sources.txt> <output name, without extension>" << std::endl;
+        return 1;
+    }
+    std::vector<Region> regions;
+    if (!Load_Regions(argv[1], regions)) {
+        return 1;
+    }
+    int atlasWidth = 0, atlasHeight = 0;
+    Pack(regions, atlasWidth, atlasHeight);
+    std::vector<unsigned char> atlas = Compose(regions, atlasWidth, atlasHeight);
+    std::string output = argv[2];
+    std::string sources = argv[1];
+    sources = sources.substr(Folder_Of(sources).size());
+    if (!WritePNG(output + ".png", atlas, atlasWidth, atlasHeight)) {
+        std::cout << "Unable to write " << output << ".png" << std::endl;
+        return 1;
+    }
+    if (!Write_Table(output + ".txt", sources, regions, atlasWidth, atlasHeight)) {
+        std::cout << "Unable to write " << output << ".txt" << std::endl;
+        return 1;
+    }
+    long sourceTexels = 0;
+    for (const Region& region : regions) {
+        sourceTexels += (long)region.width * region.height;
+    }
+    std::cout << regions.size() << " regions -> " << output << ".png (" << atlasWidth << "x" << atlasHeight << ", "
+              << (int)(100.0 * sourceTexels / ((long)atlasWidth * atlasHeight)) << "% used)" << std::endl;
+    return 0;
+}
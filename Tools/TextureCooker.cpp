@@ -0,0 +1,188 @@
+//************************************
+//Texture cooker: decodes a game's PNGs ahead of time into the .tex format in
+//CookedTexture.h, raw RGBA8 texels the game maps and uploads without running
+//stb_image at startup. TextureCache picks a .tex up in place of the PNG of
+//the same name, and falls back to the PNG when the .tex is missing or was
+//cooked from a different version of it, going by the size and FNV-1a hash
+//of the PNG's bytes stored in the header.
+//
+//--mips also stores a mip chain, each level a box filtered half of the one
+//before; leave it off for textures that are never drawn smaller than they
+//are, such as the atlases, where it only costs memory. After cooking, each
+//PNG's decode time is compared with the time to map and read its .tex.
+//
+//Build (from this folder):
+//  clang++ -std=c++11 -O2 -I"../Space Invaders/NYUCodebase" TextureCooker.cpp "../Space Invaders/NYUCodebase/MappedFile.cpp" -o texcook
+//Usage:
+//  ./texcook ../Space\ Invaders/NYUCodebase/atlas.png
+//  ./texcook --mips some_texture.png
+//which writes atlas.tex next to atlas.png.
+//************************************
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "CookedTexture.h"
+#include "MappedFile.h"
+
+//how many times each load is timed; the fastest run is reported
+const int TIMING_RUNS = 5;
+
+long File_Size(const std::string& fileName) {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+//Input: RGBA8 level and its size
+//returns the next level down, averaging each 2x2 block weighted by alpha so transparent texels don't darken the edges
+std::vector<unsigned char> Half_Level(const std::vector<unsigned char>& level, uint32_t width, uint32_t height) {
+    uint32_t halfWidth = CookedLevelSize(width, 1), halfHeight = CookedLevelSize(height, 1);
+    std::vector<unsigned char> half(halfWidth * halfHeight * 4);
+    for (uint32_t y = 0; y < halfHeight; y++) {
+        for (uint32_t x = 0; x < halfWidth; x++) {
+            unsigned int color[3] = {0, 0, 0}, alpha = 0;
+            for (uint32_t sample = 0; sample < 4; sample++) {
+                uint32_t sourceX = std::min(x * 2 + (sample & 1), width - 1);
+                uint32_t sourceY = std::min(y * 2 + (sample >> 1), height - 1);
+                const unsigned char *texel = &level[(sourceY * width + sourceX) * 4];
+                for (int channel = 0; channel < 3; channel++) {
+                    color[channel] += texel[channel] * texel[3];
+                }
+                alpha += texel[3];
+            }
+            unsigned char *out = &half[(y * halfWidth + x) * 4];
+            for (int channel = 0; channel < 3; channel++) {
+                out[channel] = alpha > 0 ? (unsigned char)((color[channel] + alpha / 2) / alpha) : 0;
+            }
+            out[3] = (unsigned char)((alpha + 2) / 4);
+        }
+    }
+    return half;
+}
+
+bool Cook(const std::string& source, const std::string& target, bool mips) {
+    int w, h, comp;
+    unsigned char *image = stbi_load(source.c_str(), &w, &h, &comp, STBI_rgb_alpha);
+    if (image == NULL) {
+        std::cout << "Unable to load " << source << std::endl;
+        return false;
+    }
+    uint32_t levels = 1;
+    if (mips) {
+        while (CookedLevelSize(w, levels - 1) > 1 || CookedLevelSize(h, levels - 1) > 1) {
+            levels++;
+        }
+    }
+    CookedTextureHeader header;
+    memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC));
+    header.version = COOKED_TEXTURE_VERSION;
+    header.width = w;
+    header.height = h;
+    header.levels = levels;
+    MappedFile png;
+    if (!png.Open(source)) {
+        std::cout << "Unable to read " << source << std::endl;
+        stbi_image_free(image);
+        return false;
+    }
+    header.sourceSize = (uint32_t)png.size;
+    header.sourceHash = CookedSourceHash(png.data, png.size);
+    header.dataOffset = sizeof(CookedTextureHeader);
+    header.fileSize = (uint32_t)(header.dataOffset + CookedTexelBytes(w, h, levels));
+
+    FILE *file = fopen(target.c_str(), "wb");
+    if (file == NULL) {
+        std::cout << "Unable to write " << target << std::endl;
+        stbi_image_free(image);
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    std::vector<unsigned char> level(image, image + (size_t)w * h * 4);
+    stbi_image_free(image);
+    for (uint32_t i = 0; written && i < levels; i++) {
+        written = fwrite(level.data(), 1, level.size(), file) == level.size();
+        if (i + 1 < levels) {
+            level = Half_Level(level, CookedLevelSize(w, i), CookedLevelSize(h, i));
+        }
+    }
+    fclose(file);
+    if (!written) {
+        std::cout << "Unable to write " << target << std::endl;
+    }
+    return written;
+}
+
+//fastest of TIMING_RUNS runs of load, in milliseconds
+template <typename Load>
+double Time_Load(Load load) {
+    double fastest = -1.0;
+    for (int run = 0; run < TIMING_RUNS; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        load();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (fastest < 0.0 || elapsed < fastest) {
+            fastest = elapsed;
+        }
+    }
+    return fastest;
+}
+
+//times what TextureCache does before the upload either way: decoding the PNG, or hashing the PNG to check
+//the .tex is current, then mapping the .tex and reading every texel
+void Compare(const std::string& source, const std::string& target) {
+    double decode = Time_Load([&]() {
+        int w, h, comp;
+        stbi_image_free(stbi_load(source.c_str(), &w, &h, &comp, STBI_rgb_alpha));
+    });
+    volatile unsigned int checksum = 0;     //keeps the reads from being optimized out
+    double mapped = Time_Load([&]() {
+        MappedFile png;
+        if (png.Open(source)) {
+            checksum += CookedSourceHash(png.data, png.size);
+        }
+        MappedFile file;
+        if (file.Open(target)) {
+            for (size_t i = 0; i < file.size; i += 64) {
+                checksum += file.data[i];
+            }
+        }
+    });
+    std::cout << source << ": PNG decode " << decode << " ms, cooked " << mapped << " ms, "
+              << File_Size(source) / 1024 << " KB -> " << File_Size(target) / 1024 << " KB" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    bool mips = false;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--mips") {
+            mips = true;
+        } else {
+            sources.push_back(argv[i]);
+        }
+    }
+    if (sources.empty()) {
+        std::cout << "usage: " << argv[0] << " [--mips] <image.png>..." << std::endl;
+        return 1;
+    }
+    for (const std::string& source : sources) {
+        std::string target = source.substr(0, source.find_last_of('.')) + ".tex";
+        if (!Cook(source, target, mips)) {
+            return 1;
+        }
+        Compare(source, target);
+    }
+    return 0;
+}
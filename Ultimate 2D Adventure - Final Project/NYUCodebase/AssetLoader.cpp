@@ -0,0 +1,121 @@
+#include "AssetLoader.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+AssetLoader::AssetLoader(int threads) : created(std::chrono::steady_clock::now()), nextJob(0), stopping(false) {
+    if (threads <= 0) {
+        threads = std::max(2, (int)std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread(&AssetLoader::Work, this, i + 1));
+    }
+}
+
+AssetLoader::~AssetLoader() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+int AssetLoader::Run(const std::string &name, std::function<void()> job) {
+    std::unique_lock<std::mutex> guard(lock);
+    Job next;
+    next.name = name;
+    next.work = job;
+    next.done = false;
+    jobs.push_back(next);
+    queued.notify_one();
+    return (int)jobs.size() - 1;
+}
+
+void AssetLoader::Wait(int job) {
+    double start = Now();
+    std::unique_lock<std::mutex> guard(lock);
+    if (jobs[job].done) {
+        return;
+    }
+    finished.wait(guard, [this, job]() { return jobs[job].done; });
+    guard.unlock();
+    AddEvent("waiting for " + jobs[job].name, 0, start, Now());
+}
+
+void AssetLoader::WaitAll() {
+    for (size_t i = 0; i < jobs.size(); i++) {
+        Wait((int)i);
+    }
+}
+
+void AssetLoader::Trace(const std::string &name, std::function<void()> work) {
+    double start = Now();
+    work();
+    AddEvent(name, 0, start, Now());
+}
+
+void AssetLoader::Work(int thread) {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        queued.wait(guard, [this]() { return stopping || nextJob < jobs.size(); });
+        // drain the queue before stopping, so every job queued gets to run
+        if (nextJob >= jobs.size()) {
+            return;
+        }
+        Job &job = jobs[nextJob++];
+        guard.unlock();
+        double start = Now();
+        job.work();
+        double end = Now();
+        guard.lock();
+        job.done = true;
+        events.push_back({job.name, thread, start, end});
+        finished.notify_all();
+    }
+}
+
+double AssetLoader::Now() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - created).count();
+}
+
+void AssetLoader::AddEvent(const std::string &name, int thread, double start, double end) {
+    std::unique_lock<std::mutex> guard(lock);
+    events.push_back({name, thread, start, end});
+}
+
+void AssetLoader::PrintTrace() const {
+    std::vector<TraceEvent> sorted;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        sorted = events;
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.start < b.start; });
+    double serial = 0.0, slowest = 0.0, last = 0.0;
+    std::cout << "Startup step   thread   start ms   end ms" << std::endl;
+    for (const TraceEvent &event : sorted) {
+        std::cout << event.name << "   " << event.thread << "   " << event.start << "   " << event.end << std::endl;
+        last = std::max(last, event.end);
+        // waits overlap the jobs they wait for, so only the work itself adds up
+        if (event.name.compare(0, 12, "waiting for ") != 0) {
+            serial += event.end - event.start;
+            slowest = std::max(slowest, event.end - event.start);
+        }
+    }
+    std::cout << "Startup took " << last << " ms; its steps take " << serial << " ms one after another, the slowest "
+              << slowest << " ms" << std::endl;
+}
+
+bool AssetLoader::ReadFile(const std::string &fileName, std::string &contents) {
+    std::ifstream infile(fileName, std::ios::binary);
+    if (!infile) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << infile.rdbuf();
+    contents = buffer.str();
+    return true;
+}
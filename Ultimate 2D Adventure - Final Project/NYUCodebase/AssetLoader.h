@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// A pool of worker threads for startup loading. Jobs that only read files
+// and decode them run on the workers, in the order they were queued, while
+// the main thread keeps the work that needs the GL context and waits for
+// each job just before it needs the result. Every job, and every step the
+// main thread passes to Trace, is timed for the startup trace.
+class AssetLoader {
+    public:
+        // threads of 0 uses one per hardware thread, and at least two so a
+        // job blocked on the disk never holds up all the others
+        AssetLoader(int threads = 0);
+        // waits for the queued jobs to finish
+        ~AssetLoader();
+
+        // queues job and returns its index, for Wait
+        int Run(const std::string &name, std::function<void()> job);
+        // blocks until the job finishes; the time blocked is traced on the main thread
+        void Wait(int job);
+        void WaitAll();
+        // runs work on the calling thread and traces it
+        void Trace(const std::string &name, std::function<void()> work);
+
+        // every traced step, the time from construction to the last step
+        // finishing, and what the same steps would take one after another
+        void PrintTrace() const;
+        // reads a whole file, returning false when it can't be opened
+        static bool ReadFile(const std::string &fileName, std::string &contents);
+
+        struct TraceEvent {
+            std::string name;
+            int thread;         // 0 is the main thread, workers count up from 1
+            double start;       // milliseconds since the loader was constructed
+            double end;
+        };
+        std::vector<TraceEvent> events;
+
+    private:
+        struct Job {
+            std::string name;
+            std::function<void()> work;
+            bool done;
+        };
+
+        AssetLoader(const AssetLoader &) = delete;
+        AssetLoader &operator=(const AssetLoader &) = delete;
+
+        void Work(int thread);
+        double Now() const;
+        void AddEvent(const std::string &name, int thread, double start, double end);
+
+        std::chrono::steady_clock::time_point created;
+        std::vector<std::thread> workers;
+        std::deque<Job> jobs;       // a deque, so queuing never moves a job a worker is running
+        size_t nextJob;
+        bool stopping;
+        mutable std::mutex lock;
+        std::condition_variable queued;
+        std::condition_variable finished;
+};
@@ -0,0 +1,377 @@
+#include "ChunkedMap.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+ChunkedMap::ChunkedMap() {
+	mapWidth = -1;
+	mapHeight = -1;
+	chunkSize = FLARE_WORLD_CHUNK_SIZE;
+	chunkCountX = 0;
+	chunkCountY = 0;
+	collisionLayer = -1;
+	loadRadius = 1;
+	keepRadius = 2;
+	inFlight = 0;
+	failedChunk = -1;
+	stopping = false;
+}
+
+ChunkedMap::~ChunkedMap() {
+	Close();
+}
+
+bool ChunkedMap::Open(const std::string fileName) {
+	Close();
+	std::ifstream infile(fileName, std::ios::binary);
+	if(infile.fail()) {
+		return false;
+	}
+	infile.seekg(0, std::ios::end);
+	uint64_t fileLength = (uint64_t)infile.tellg();
+	infile.seekg(0);
+	FlareWorldFileHeader header;
+	infile.read((char*)&header, sizeof(header));
+	if(!infile.good() || memcmp(header.magic, FLARE_WORLD_MAGIC, sizeof(FLARE_WORLD_MAGIC)) != 0 ||
+		header.version != FLARE_WORLD_VERSION || header.fileSize != fileLength ||
+		header.mapWidth <= 0 || header.mapHeight <= 0 ||
+		header.chunkSize <= 0 || header.chunkSize > FLARE_WORLD_MAX_CHUNK_SIZE ||
+		header.layerCount > FLARE_WORLD_MAX_LAYERS ||
+		header.chunkCountX != (header.mapWidth + header.chunkSize - 1) / header.chunkSize ||
+		header.chunkCountY != (header.mapHeight + header.chunkSize - 1) / header.chunkSize) {
+		return false;
+	}
+	// the tables must lie inside the file before anything is sized from their counts
+	uint64_t chunkCount = (uint64_t)header.chunkCountX * header.chunkCountY;
+	uint64_t chunkTableEnd = header.chunkOffset + chunkCount * sizeof(FlareWorldFileChunk);
+	if(header.layerOffset % sizeof(uint32_t) != 0 ||
+		header.layerOffset + (uint64_t)header.layerCount * sizeof(FlareMapFileLayer) > fileLength ||
+		header.entityOffset % sizeof(uint32_t) != 0 ||
+		header.entityOffset + (uint64_t)header.entityCount * sizeof(FlareMapFileEntity) > fileLength ||
+		header.chunkOffset % sizeof(uint32_t) != 0 || chunkTableEnd > fileLength) {
+		return false;
+	}
+
+	std::vector<FlareMapFileLayer> fileLayers(header.layerCount);
+	infile.seekg(header.layerOffset);
+	infile.read((char*)fileLayers.data(), fileLayers.size() * sizeof(FlareMapFileLayer));
+	std::vector<FlareMapFileEntity> fileEntities(header.entityCount);
+	infile.seekg(header.entityOffset);
+	infile.read((char*)fileEntities.data(), fileEntities.size() * sizeof(FlareMapFileEntity));
+	std::vector<FlareWorldFileChunk> fileChunks((size_t)chunkCount);
+	infile.seekg(header.chunkOffset);
+	infile.read((char*)fileChunks.data(), fileChunks.size() * sizeof(FlareWorldFileChunk));
+	if(!infile.good()) {
+		return false;
+	}
+	for(const FlareMapFileLayer &record : fileLayers) {
+		if(record.role > LAYER_DECORATION) {
+			return false;
+		}
+	}
+	uint64_t chunkBytes = (uint64_t)header.layerCount * header.chunkSize * header.chunkSize * sizeof(FlareTile);
+	for(const FlareWorldFileChunk &chunk : fileChunks) {
+		bool valid;
+		if(chunk.size == 0) {
+			valid = chunk.encoding == FLARE_ENCODING_RAW && chunk.offset == 0;
+		} else {
+			valid = (chunk.encoding == FLARE_ENCODING_RLE ||
+					(chunk.encoding == FLARE_ENCODING_RAW && chunk.size == chunkBytes)) &&
+				chunk.offset >= chunkTableEnd && chunk.offset <= fileLength && chunk.size <= fileLength - chunk.offset;
+		}
+		if(!valid) {
+			return false;	// stale or foreign file, the caller can fall back to the whole map
+		}
+	}
+
+	mapWidth = header.mapWidth;
+	mapHeight = header.mapHeight;
+	chunkSize = header.chunkSize;
+	chunkCountX = header.chunkCountX;
+	chunkCountY = header.chunkCountY;
+	layers.resize(header.layerCount);
+	for(uint32_t i=0; i < header.layerCount; i++) {
+		layers[i].name = std::string(fileLayers[i].name, strnlen(fileLayers[i].name, sizeof(fileLayers[i].name)));
+		layers[i].role = (FlareLayerRole)fileLayers[i].role;
+		layers[i].tiles = nullptr;
+		if(layers[i].role == LAYER_COLLISION && collisionLayer < 0) {
+			collisionLayer = (int)i;
+		}
+	}
+	entities.reserve(header.entityCount);
+	for(const FlareMapFileEntity &fileEntity : fileEntities) {
+		entities.push_back(FlareMap::EntityFromFile(fileEntity));
+	}
+	chunkIndex.swap(fileChunks);
+	resident.assign(chunkIndex.size(), nullptr);
+	requested.assign(chunkIndex.size(), false);
+
+	this->fileName = fileName;
+	stopping = false;
+	inFlight = 0;
+	failedChunk = -1;
+	loader = std::thread(&ChunkedMap::LoaderThread, this);
+	return true;
+}
+
+void ChunkedMap::Close() {
+	if(loader.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueReady.notify_all();
+		loader.join();
+	}
+	for(int index : residentChunks) {
+		delete resident[index];
+	}
+	for(MapChunk *chunk : finished) {
+		delete chunk;
+	}
+	finished.clear();
+	pending.clear();
+	residentChunks.clear();
+	resident.clear();
+	requested.clear();
+	chunkIndex.clear();
+	layers.clear();
+	entities.clear();
+	mapWidth = -1;
+	mapHeight = -1;
+	chunkCountX = 0;
+	chunkCountY = 0;
+	collisionLayer = -1;
+	failedChunk = -1;
+}
+
+bool ChunkedMap::ReadChunk(std::ifstream &file, int index, MapChunk &chunk, std::vector<unsigned char> &buffer) {
+	const FlareWorldFileChunk &entry = chunkIndex[index];
+	chunk.chunkX = index % chunkCountX;
+	chunk.chunkY = index / chunkCountX;
+	chunk.tiles.resize(layers.size() * chunkSize * chunkSize);
+	file.clear();
+	file.seekg(entry.offset);
+	if(entry.encoding == FLARE_ENCODING_RAW) {
+		file.read((char*)chunk.tiles.data(), entry.size);
+		return file.good();
+	}
+	buffer.resize(entry.size);
+	file.read((char*)buffer.data(), entry.size);
+	return file.good() && FlareMap::DecodeRLE(buffer.data(), buffer.size(), chunk.tiles.data(), chunk.tiles.size());
+}
+
+void ChunkedMap::LoaderThread() {
+	// the loader keeps its own stream, so reads never contend with the game thread
+	std::ifstream file(fileName, std::ios::binary);
+	std::vector<unsigned char> buffer;
+	std::unique_lock<std::mutex> lock(queueMutex);
+	while(true) {
+		queueReady.wait(lock, [this] { return stopping || !pending.empty(); });
+		if(stopping) {
+			break;
+		}
+		int index = pending.front();
+		pending.pop_front();
+		inFlight++;
+		lock.unlock();
+
+		MapChunk *chunk = new MapChunk();
+		bool read = ReadChunk(file, index, *chunk, buffer);
+
+		lock.lock();
+		if(read) {
+			finished.push_back(chunk);
+		} else {
+			delete chunk;	// truncated or corrupt world file, Update closes the world
+			if(failedChunk < 0) {
+				failedChunk = index;
+			}
+		}
+		inFlight--;
+		loadFinished.notify_all();
+	}
+}
+
+bool ChunkedMap::Update(int tileX, int tileY, bool wait) {
+	if(!IsOpen()) {
+		return true;
+	}
+	// floor division so tiles left of or above the map land in chunk -1
+	int cameraX = (tileX >= 0 ? tileX : tileX - chunkSize + 1) / chunkSize;
+	int cameraY = (tileY >= 0 ? tileY : tileY - chunkSize + 1) / chunkSize;
+
+	// free chunks that drifted out of range
+	for(size_t i=0; i < residentChunks.size();) {
+		int index = residentChunks[i];
+		int chunkX = index % chunkCountX;
+		int chunkY = index / chunkCountX;
+		if(std::max(abs(chunkX - cameraX), abs(chunkY - cameraY)) > keepRadius) {
+			delete resident[index];
+			resident[index] = nullptr;
+			requested[index] = false;
+			residentChunks[i] = residentChunks.back();
+			residentChunks.pop_back();
+		} else {
+			i++;
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(queueMutex);
+	// drop queued loads that are no longer wanted
+	for(size_t i=0; i < pending.size();) {
+		int index = pending[i];
+		if(std::max(abs(index % chunkCountX - cameraX), abs(index / chunkCountX - cameraY)) > keepRadius) {
+			requested[index] = false;
+			pending.erase(pending.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	// queue missing chunks ring by ring, nearest first
+	bool queued = false;
+	for(int ring=0; ring <= loadRadius; ring++) {
+		for(int chunkY = cameraY - ring; chunkY <= cameraY + ring; chunkY++) {
+			for(int chunkX = cameraX - ring; chunkX <= cameraX + ring; chunkX++) {
+				if(std::max(abs(chunkX - cameraX), abs(chunkY - cameraY)) != ring ||
+					chunkX < 0 || chunkY < 0 || chunkX >= chunkCountX || chunkY >= chunkCountY) {
+					continue;
+				}
+				int index = chunkY * chunkCountX + chunkX;
+				if(!requested[index] && chunkIndex[index].size != 0) {
+					requested[index] = true;
+					pending.push_back(index);
+					queued = true;
+				}
+			}
+		}
+	}
+	if(queued) {
+		queueReady.notify_one();
+	}
+	if(wait) {
+		loadFinished.wait(lock, [this] { return pending.empty() && inFlight == 0; });
+	}
+
+	// install whatever the loader has finished since the last call
+	std::vector<MapChunk*> done;
+	done.swap(finished);
+	bool failed = failedChunk >= 0;
+	lock.unlock();
+	if(failed) {
+		for(MapChunk *chunk : done) {
+			delete chunk;
+		}
+		Close();
+		return false;
+	}
+	for(MapChunk *chunk : done) {
+		int index = chunk->chunkY * chunkCountX + chunk->chunkX;
+		if(requested[index] && resident[index] == nullptr) {
+			resident[index] = chunk;
+			residentChunks.push_back(index);
+		} else {
+			delete chunk;	// evicted while it was loading
+		}
+	}
+	return true;
+}
+
+namespace {
+	// copies every layer's tiles for one chunk, padding past the map edge with
+	// empty tiles, and reports whether any tile was set
+	bool GatherChunk(const FlareMap &map, int chunkX, int chunkY, int chunkSize, std::vector<FlareTile> &out) {
+		out.assign(map.layers.size() * chunkSize * chunkSize, 0);
+		bool used = false;
+		for(size_t layer=0; layer < map.layers.size(); layer++) {
+			for(int y=0; y < chunkSize; y++) {
+				for(int x=0; x < chunkSize; x++) {
+					FlareTile tile = map.GetTile((int)layer, chunkX * chunkSize + x, chunkY * chunkSize + y);
+					out[(layer * chunkSize + y) * chunkSize + x] = tile;
+					used = used || tile != 0;
+				}
+			}
+		}
+		return used;
+	}
+}
+
+bool ChunkedMap::Save(const FlareMap &map, const std::string fileName) {
+	if(map.mapWidth <= 0 || map.mapHeight <= 0) {
+		return false;
+	}
+	FlareWorldFileHeader header;
+	memcpy(header.magic, FLARE_WORLD_MAGIC, sizeof(FLARE_WORLD_MAGIC));
+	header.version = FLARE_WORLD_VERSION;
+	header.mapWidth = map.mapWidth;
+	header.mapHeight = map.mapHeight;
+	header.chunkSize = FLARE_WORLD_CHUNK_SIZE;
+	header.chunkCountX = (map.mapWidth + FLARE_WORLD_CHUNK_SIZE - 1) / FLARE_WORLD_CHUNK_SIZE;
+	header.chunkCountY = (map.mapHeight + FLARE_WORLD_CHUNK_SIZE - 1) / FLARE_WORLD_CHUNK_SIZE;
+	header.layerCount = (uint32_t)map.layers.size();
+	header.layerOffset = sizeof(FlareWorldFileHeader);
+	header.entityCount = (uint32_t)map.entities.size();
+	header.entityOffset = header.layerOffset + header.layerCount * sizeof(FlareMapFileLayer);
+	header.chunkOffset = header.entityOffset + header.entityCount * sizeof(FlareMapFileEntity);
+
+	// first pass lays out the chunks that have tiles, RLE encoded when that is
+	// smaller, and the second writes them
+	uint32_t chunkBytes = header.layerCount * FLARE_WORLD_CHUNK_SIZE * FLARE_WORLD_CHUNK_SIZE * sizeof(FlareTile);
+	std::vector<FlareWorldFileChunk> chunks((size_t)header.chunkCountX * header.chunkCountY);
+	std::vector<FlareTile> tiles;
+	std::vector<unsigned char> encoded;
+	uint64_t offset = header.chunkOffset + chunks.size() * sizeof(FlareWorldFileChunk);
+	for(size_t i=0; i < chunks.size(); i++) {
+		chunks[i].offset = 0;
+		chunks[i].size = 0;
+		chunks[i].encoding = FLARE_ENCODING_RAW;
+		if(GatherChunk(map, (int)(i % header.chunkCountX), (int)(i / header.chunkCountX), FLARE_WORLD_CHUNK_SIZE, tiles)) {
+			FlareMap::EncodeRLE(tiles.data(), tiles.size(), encoded);
+			chunks[i].offset = offset;
+			if(encoded.size() < chunkBytes) {
+				chunks[i].encoding = FLARE_ENCODING_RLE;
+				chunks[i].size = (uint32_t)encoded.size();
+			} else {
+				chunks[i].size = chunkBytes;
+			}
+			offset += chunks[i].size;
+		}
+	}
+	header.fileSize = offset;
+
+	std::ofstream outfile(fileName, std::ios::binary);
+	if(outfile.fail()) {
+		return false;
+	}
+	outfile.write((const char*)&header, sizeof(header));
+	for(const FlareMapLayer &layer : map.layers) {
+		FlareMapFileLayer record;
+		memset(&record, 0, sizeof(record));
+		if(layer.name.size() >= sizeof(record.name)) {
+			return false;	// names are stored inline and must leave room for a terminator
+		}
+		memcpy(record.name, layer.name.c_str(), layer.name.size());
+		record.role = layer.role;
+		outfile.write((const char*)&record, sizeof(record));
+	}
+	for(const FlareMapEntity &entity : map.entities) {
+		FlareMapFileEntity record;
+		if(!FlareMap::EntityToFile(entity, record)) {
+			return false;
+		}
+		outfile.write((const char*)&record, sizeof(record));
+	}
+	outfile.write((const char*)chunks.data(), chunks.size() * sizeof(FlareWorldFileChunk));
+	for(size_t i=0; i < chunks.size(); i++) {
+		if(chunks[i].size != 0) {
+			GatherChunk(map, (int)(i % header.chunkCountX), (int)(i / header.chunkCountX), FLARE_WORLD_CHUNK_SIZE, tiles);
+			if(chunks[i].encoding == FLARE_ENCODING_RLE) {
+				FlareMap::EncodeRLE(tiles.data(), tiles.size(), encoded);
+				outfile.write((const char*)encoded.data(), encoded.size());
+			} else {
+				outfile.write((const char*)tiles.data(), chunkBytes);
+			}
+		}
+	}
+	return outfile.good();
+}
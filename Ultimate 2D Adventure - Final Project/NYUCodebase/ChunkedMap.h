@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "FlareMap.h"
+
+// Streamed world (.flw) layout, written by the level compiler in Tools/.
+// The map is cut into square chunks holding every layer's tiles for that
+// square. Only the header, layer table, chunk index and entity table are
+// kept in memory; chunk tiles are read on demand. Chunks that are empty in
+// every layer are not stored at all.
+const char FLARE_WORLD_MAGIC[4] = {'F', 'L', 'W', 'D'};
+const uint32_t FLARE_WORLD_VERSION = 3;
+const int FLARE_WORLD_CHUNK_SIZE = 32;
+// limits Open accepts, so a corrupt header can't ask for huge chunk buffers
+const int FLARE_WORLD_MAX_CHUNK_SIZE = 256;
+const uint32_t FLARE_WORLD_MAX_LAYERS = 64;
+
+struct FlareWorldFileHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t mapWidth;
+	int32_t mapHeight;
+	int32_t chunkSize;
+	int32_t chunkCountX;
+	int32_t chunkCountY;
+	uint32_t layerCount;
+	uint32_t layerOffset;		// layerCount FlareMapFileLayer records, data fields unused
+	uint32_t chunkOffset;		// chunkCountX * chunkCountY FlareWorldFileChunk records, row-major
+	uint32_t entityCount;
+	uint32_t entityOffset;		// entityCount FlareMapFileEntity records
+	uint64_t fileSize;
+};
+
+struct FlareWorldFileChunk {
+	uint64_t offset;			// layerCount * chunkSize * chunkSize FlareTiles, layer after layer
+	uint32_t size;				// 0 for a chunk with no tiles, which is stored raw at offset 0
+	uint32_t encoding;			// FlareTileEncoding
+};
+
+struct MapChunk {
+	int chunkX;
+	int chunkY;
+	// layerCount blocks of chunkSize * chunkSize row-major tiles; cells past
+	// the map edge are empty
+	std::vector<FlareTile> tiles;
+};
+
+class ChunkedMap {
+	public:
+		ChunkedMap();
+		~ChunkedMap();
+
+		bool Open(const std::string fileName);
+		void Close();
+		bool IsOpen() const { return chunkIndex.size() > 0; }
+
+		// writes a loaded map out as a streamed world
+		static bool Save(const FlareMap &map, const std::string fileName);
+
+		// Installs chunks the loader thread has finished, queues the chunks
+		// within loadRadius of the given tile and frees the ones beyond
+		// keepRadius. Call once per frame with the camera position; with wait
+		// set the call returns only once everything queued is resident.
+		// Returns false when a chunk couldn't be read from the file; the world
+		// is closed by then, and the caller should load the whole map instead.
+		bool Update(int tileX, int tileY, bool wait = false);
+
+		// tile at (x, y) of a layer, or an empty tile when the cell is outside
+		// the map or its chunk isn't resident
+		FlareTile GetTile(int layer, int x, int y) const {
+			if(x < 0 || y < 0 || x >= mapWidth || y >= mapHeight) {
+				return 0;
+			}
+			const MapChunk *chunk = resident[(y / chunkSize) * chunkCountX + x / chunkSize];
+			if(chunk == nullptr) {
+				return 0;
+			}
+			return chunk->tiles[(layer * chunkSize + y % chunkSize) * chunkSize + x % chunkSize];
+		}
+
+		FlareTile GetCollisionTile(int x, int y) const {
+			if(collisionLayer < 0) {
+				return 0;
+			}
+			return GetTile(collisionLayer, x, y);
+		}
+
+		int mapWidth;
+		int mapHeight;
+		int chunkSize;
+		int chunkCountX;
+		int chunkCountY;
+		std::vector<FlareMapLayer> layers;	// names and roles only, tiles live in the chunks
+		int collisionLayer;
+		std::vector<FlareMapEntity> entities;
+
+		// radii in chunks around the camera chunk; the gap between them keeps
+		// chunks from thrashing when the camera sits on a boundary
+		int loadRadius;
+		int keepRadius;
+
+		// resident chunk for every chunk index, or null; its length follows the
+		// chunk index while the chunks themselves are bounded by keepRadius
+		std::vector<MapChunk*> resident;
+		// indices of the chunks currently resident, in no particular order
+		std::vector<int> residentChunks;
+
+	private:
+		ChunkedMap(const ChunkedMap &) = delete;
+		ChunkedMap &operator=(const ChunkedMap &) = delete;
+
+		void LoaderThread();
+		bool ReadChunk(std::ifstream &file, int index, MapChunk &chunk, std::vector<unsigned char> &buffer);
+
+		std::string fileName;
+		std::vector<FlareWorldFileChunk> chunkIndex;
+		std::vector<bool> requested;	// queued, loading or resident; only touched by the game thread
+
+		std::thread loader;
+		std::mutex queueMutex;
+		std::condition_variable queueReady;
+		std::condition_variable loadFinished;
+		std::deque<int> pending;
+		std::vector<MapChunk*> finished;
+		int inFlight;
+		int failedChunk;				// a chunk the loader couldn't read, or -1
+		bool stopping;
+};
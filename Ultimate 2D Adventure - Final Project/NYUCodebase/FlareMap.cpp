@@ -1,122 +1,623 @@
 
 #include "FlareMap.h"
+#include "MappedFile.h"
 #include <fstream>
 #include <string>
-#include <iostream>
-#include <sstream>
-#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <cctype>
+#include <climits>
 
 FlareMap::FlareMap() {
-	mapData = nullptr;
 	mapWidth = -1;
 	mapHeight = -1;
+	collisionLayer = -1;
+	mappedFile = nullptr;
 }
 
-FlareMap::~FlareMap() {
-	for(int i=0; i < mapHeight; i++) {
-		delete mapData[i];
+FlareMap::FlareMap(FlareMap &&other) {
+	mappedFile = nullptr;
+	*this = std::move(other);
+}
+
+FlareMap &FlareMap::operator=(FlareMap &&other) {
+	if(this != &other) {
+		Clear();
+		mapWidth = other.mapWidth;
+		mapHeight = other.mapHeight;
+		// moving the vector keeps every layer's buffer, so the tile pointers stay valid
+		layers = std::move(other.layers);
+		collisionLayer = other.collisionLayer;
+		entities = std::move(other.entities);
+		mappedFile = other.mappedFile;
+		other.mappedFile = nullptr;
+		other.Clear();
 	}
-	delete mapData;
+	return *this;
+}
+
+FlareMap::~FlareMap() {
+	Clear();
 }
 
-bool FlareMap::ReadHeader(std::ifstream &stream) {
-	std::string line;
+void FlareMap::Clear() {
+	layers.clear();
+	entities.clear();
+	delete mappedFile;
+	mappedFile = nullptr;
 	mapWidth = -1;
 	mapHeight = -1;
-	while(std::getline(stream, line)) {
-		if(line == "") { break; }
-		std::istringstream sStream(line);
-		std::string key,value;
-		std::getline(sStream, key, '=');
-		std::getline(sStream, value);
-		if(key == "width") {
-			mapWidth = std::atoi(value.c_str());
-		} else if(key == "height"){
-			mapHeight = std::atoi(value.c_str());
-		}
-	}
-	if(mapWidth == -1 || mapHeight == -1) {
+	collisionLayer = -1;
+}
+
+unsigned int FlareMap::parseThreads = 0;
+std::unordered_map<std::string, int> FlareMap::entityTypeIds;
+
+int FlareMap::RegisterEntityType(const std::string &type) {
+	std::unordered_map<std::string, int>::iterator it = entityTypeIds.find(type);
+	if(it != entityTypeIds.end()) {
+		return it->second;
+	}
+	int id = (int)entityTypeIds.size();
+	entityTypeIds[type] = id;
+	return id;
+}
+
+int FlareMap::FindEntityType(const std::string &type) {
+	std::unordered_map<std::string, int>::const_iterator it = entityTypeIds.find(type);
+	return it != entityTypeIds.end() ? it->second : FLARE_UNKNOWN_TYPE;
+}
+
+FlareMapEntity FlareMap::EntityFromFile(const FlareMapFileEntity &record) {
+	FlareMapEntity entity;
+	entity.type = std::string(record.type, strnlen(record.type, sizeof(record.type)));
+	entity.typeId = FindEntityType(entity.type);
+	entity.x = record.x;
+	entity.y = record.y;
+	entity.width = record.width;
+	entity.height = record.height;
+	return entity;
+}
+
+bool FlareMap::EntityToFile(const FlareMapEntity &entity, FlareMapFileEntity &record) {
+	memset(&record, 0, sizeof(record));
+	if(entity.type.size() >= sizeof(record.type)) {
+		return false;	// type names are stored inline and must leave room for a terminator
+	}
+	memcpy(record.type, entity.type.c_str(), entity.type.size());
+	record.x = entity.x;
+	record.y = entity.y;
+	record.width = entity.width;
+	record.height = entity.height;
+	return true;
+}
+
+namespace {
+
+	// Parsing works on [begin, end) ranges of the mapped file; nothing is copied.
+	struct TextRange {
+		const char *begin;
+		const char *end;
+	};
+
+	bool Equals(const TextRange &range, const char *literal) {
+		size_t length = strlen(literal);
+		return (size_t)(range.end - range.begin) == length && memcmp(range.begin, literal, length) == 0;
+	}
+
+	// Reads the line at cursor without its terminator and advances past it.
+	bool NextLine(const char *&cursor, const char *end, TextRange &line) {
+		if(cursor >= end) {
+			return false;
+		}
+		const char *newline = (const char*)memchr(cursor, '\n', end - cursor);
+		line.begin = cursor;
+		line.end = newline ? newline : end;
+		cursor = newline ? newline + 1 : end;
+		if(line.end > line.begin && line.end[-1] == '\r') {
+			line.end--;
+		}
+		return true;
+	}
+
+	void SplitKeyValue(const TextRange &line, TextRange &key, TextRange &value) {
+		const char *equals = (const char*)memchr(line.begin, '=', line.end - line.begin);
+		key.begin = line.begin;
+		key.end = equals ? equals : line.end;
+		value.begin = equals ? equals + 1 : line.end;
+		value.end = line.end;
+	}
+
+	void SkipBlanks(const char *&p, const char *end) {
+		while(p < end && (*p == ' ' || *p == '\t')) {
+			p++;
+		}
+	}
+
+	// Decimal integer at p after any spaces or tabs, leaving p on the first
+	// character after it. Values too large for an int stop at INT_MAX.
+	int ParseInt(const char *&p, const char *end) {
+		SkipBlanks(p, end);
+		bool negative = false;
+		if(p < end && *p == '-') {
+			negative = true;
+			p++;
+		}
+		int value = 0;
+		while(p < end && *p >= '0' && *p <= '9') {
+			int digit = *p - '0';
+			value = value > (INT_MAX - digit) / 10 ? INT_MAX : value * 10 + digit;
+			p++;
+		}
+		return negative ? -value : value;
+	}
+
+	// ParseInt for a tile token, failing when there are no digits or the
+	// value is negative or too large for a FlareTile
+	bool ParseTileValue(const char *&p, const char *end, int &value) {
+		SkipBlanks(p, end);
+		const char *digits = p;
+		value = ParseInt(p, end);
+		SkipBlanks(p, end);
+		return p != digits && value >= 0 && value <= 0xFFFF;
+	}
+
+	bool ContainsNoCase(const TextRange &range, const char *word) {
+		size_t length = strlen(word);
+		for(const char *p = range.begin; p + length <= range.end; p++) {
+			size_t i = 0;
+			while(i < length && tolower((unsigned char)p[i]) == word[i]) {
+				i++;
+			}
+			if(i == length) {
+				return true;
+			}
+		}
 		return false;
-	} else {
-		mapData = new unsigned int*[mapHeight];
-		for(int i = 0; i < mapHeight; ++i) {
-			mapData[i] = new unsigned int[mapWidth];
+	}
+
+	// Reads a layer role out of a role= value or a layer name such as "Collision" or "bg_background".
+	bool ParseLayerRole(const TextRange &text, FlareLayerRole &role) {
+		if(ContainsNoCase(text, "collision")) {
+			role = LAYER_COLLISION;
+		} else if(ContainsNoCase(text, "background")) {
+			role = LAYER_BACKGROUND;
+		} else if(ContainsNoCase(text, "foreground")) {
+			role = LAYER_FOREGROUND;
+		} else if(ContainsNoCase(text, "decoration")) {
+			role = LAYER_DECORATION;
+		} else {
+			return false;
 		}
 		return true;
 	}
+
+	// Decodes rows [firstRow, lastRow) of a layer's comma separated data block.
+	// A count*tile token expands to a run straight into the row. Returns false
+	// on a token that isn't a number or doesn't fit a FlareTile.
+	bool DecodeRows(const std::vector<TextRange> &rows, int firstRow, int lastRow, int width, FlareTile *tiles) {
+		for(int y=firstRow; y < lastRow; y++) {
+			const char *p = rows[y].begin;
+			const char *end = rows[y].end;
+			FlareTile *row = tiles + y * width;
+			SkipBlanks(p, end);
+			for(int x=0; x < width && p < end;) {
+				int val;
+				if(!ParseTileValue(p, end, val)) {
+					return false;
+				}
+				int run = 1;
+				if(p < end && *p == '*') {
+					p++;
+					run = val;
+					if(!ParseTileValue(p, end, val)) {
+						return false;
+					}
+				}
+				FlareTile tile = val > 0 ? (FlareTile)(val-1) : 0;
+				for(int i=0; i < run && x < width; i++) {
+					row[x++] = tile;
+				}
+				if(p < end && *p == ',') {
+					p++;
+					SkipBlanks(p, end);
+				}
+			}
+		}
+		return true;
+	}
+
+	void PutVarint(std::vector<unsigned char> &out, uint32_t value) {
+		while(value >= 0x80) {
+			out.push_back((unsigned char)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((unsigned char)value);
+	}
+
+	bool GetVarint(const unsigned char *&p, const unsigned char *end, uint32_t &value) {
+		value = 0;
+		for(int shift=0; shift < 35; shift += 7) {
+			if(p >= end) {
+				return false;
+			}
+			unsigned char byte = *p++;
+			value |= (uint32_t)(byte & 0x7F) << shift;
+			if(!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const char *ROLE_NAMES[] = {"background", "collision", "foreground", "decoration"};
+
+	// Below this many tiles a layer is decoded on the calling thread.
+	const size_t PARALLEL_DECODE_TILES = 64 * 1024;
+
+	// Decodes a whole layer, splitting large ones into row bands across threads.
+	bool DecodeLayer(const std::vector<TextRange> &rows, int mapWidth, int mapHeight, FlareTile *out) {
+		unsigned int threadCount = FlareMap::parseThreads;
+		if(threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		if((size_t)mapWidth * mapHeight < PARALLEL_DECODE_TILES) {
+			threadCount = 1;
+		}
+		threadCount = std::min(threadCount, (unsigned int)mapHeight);
+
+		if(threadCount <= 1) {
+			return DecodeRows(rows, 0, mapHeight, mapWidth, out);
+		}
+		std::vector<std::thread> workers;
+		std::vector<char> decoded(threadCount, 0);	// each band's result; not vector<bool>, whose bits share bytes
+		int rowsPerThread = (mapHeight + threadCount - 1) / threadCount;
+		for(unsigned int i=1; i < threadCount; i++) {
+			int firstRow = std::min(mapHeight, (int)i * rowsPerThread);
+			int lastRow = std::min(mapHeight, firstRow + rowsPerThread);
+			char *result = &decoded[i];
+			workers.push_back(std::thread([&rows, firstRow, lastRow, mapWidth, out, result]() {
+				*result = DecodeRows(rows, firstRow, lastRow, mapWidth, out);
+			}));
+		}
+		decoded[0] = DecodeRows(rows, 0, std::min(mapHeight, rowsPerThread), mapWidth, out);
+		for(std::thread &worker : workers) {
+			worker.join();
+		}
+		return std::find(decoded.begin(), decoded.end(), 0) == decoded.end();
+	}
 }
 
-bool FlareMap::ReadLayerData(std::ifstream &stream) {
-	std::string line;
-	while(getline(stream, line)) {
-		if(line == "") { break; }
-		std::istringstream sStream(line);
-		std::string key,value;
-		std::getline(sStream, key, '=');
-		std::getline(sStream, value);
-		if(key == "data") {
+void FlareMap::EncodeRLE(const FlareTile *tiles, size_t count, std::vector<unsigned char> &out) {
+	out.clear();
+	for(size_t i=0; i < count;) {
+		size_t run = 1;
+		while(i + run < count && tiles[i + run] == tiles[i]) {
+			run++;
+		}
+		PutVarint(out, (uint32_t)run);
+		PutVarint(out, tiles[i]);
+		i += run;
+	}
+}
+
+bool FlareMap::DecodeRLE(const unsigned char *data, size_t size, FlareTile *tiles, size_t count) {
+	const unsigned char *end = data + size;
+	size_t i = 0;
+	while(i < count) {
+		uint32_t run, tile;
+		if(!GetVarint(data, end, run) || !GetVarint(data, end, tile) || run == 0 || run > count - i || tile > 0xFFFF) {
+			return false;
+		}
+		std::fill(tiles + i, tiles + i + run, (FlareTile)tile);
+		i += run;
+	}
+	return data == end;
+}
+
+bool FlareMap::ReadHeader(const char *&cursor, const char *end) {
+	TextRange line, key, value;
+	mapWidth = -1;
+	mapHeight = -1;
+	while(NextLine(cursor, end, line)) {
+		if(line.begin == line.end) { break; }
+		SplitKeyValue(line, key, value);
+		if(Equals(key, "width")) {
+			mapWidth = ParseInt(value.begin, value.end);
+		} else if(Equals(key, "height")) {
+			mapHeight = ParseInt(value.begin, value.end);
+		}
+	}
+	return mapWidth > 0 && mapHeight > 0;
+}
+
+bool FlareMap::ReadLayerData(const char *&cursor, const char *end, bool &explicitRole) {
+	if(mapWidth <= 0 || mapHeight <= 0) {
+		return false;	// layer before header
+	}
+	FlareMapLayer layer;
+	layer.role = LAYER_DECORATION;
+	layer.tileStorage.assign((size_t)mapWidth * mapHeight, 0);
+	bool roleKey = false;
+	explicitRole = false;
+
+	TextRange line, key, value;
+	while(NextLine(cursor, end, line)) {
+		if(line.begin == line.end) { break; }
+		SplitKeyValue(line, key, value);
+		if(Equals(key, "type")) {
+			layer.name.assign(value.begin, value.end);
+			if(!roleKey && ParseLayerRole(value, layer.role)) {
+				explicitRole = true;
+			}
+		} else if(Equals(key, "role")) {
+			if(ParseLayerRole(value, layer.role)) {
+				roleKey = true;
+				explicitRole = true;
+			}
+		} else if(Equals(key, "data")) {
+			// one quick pass finds where every row starts, then the rows are
+			// decoded independently
+			std::vector<TextRange> rows(mapHeight);
 			for(int y=0; y < mapHeight; y++) {
-				getline(stream, line);
-				std::istringstream lineStream(line);
-				std::string tile;
-				for(int x=0; x < mapWidth; x++) {
-					std::getline(lineStream, tile, ',');
-					unsigned int val = atoi(tile.c_str());
-					if(val > 0) {
-						mapData[y][x] = val-1;
-					} else {
-						mapData[y][x] = 0;
-					}
+				if(!NextLine(cursor, end, rows[y])) {
+					rows[y].begin = rows[y].end = end;
 				}
 			}
+			if(!DecodeLayer(rows, mapWidth, mapHeight, layer.tileStorage.data())) {
+				return false;
+			}
 		}
 	}
+	layer.tiles = layer.tileStorage.data();
+	layers.push_back(std::move(layer));
 	return true;
 }
 
-
-bool FlareMap::ReadEntityData(std::ifstream &stream) {
-	std::string line;
-	std::string type;
-	while(getline(stream, line)) {
-		if(line == "") { break; }
-		std::istringstream sStream(line);
-		std::string key,value;
-		getline(sStream, key, '=');
-		getline(sStream, value);
-		if(key == "type") {
+bool FlareMap::ReadEntityData(const char *&cursor, const char *end) {
+	TextRange line, key, value;
+	TextRange type = {end, end};
+	while(NextLine(cursor, end, line)) {
+		if(line.begin == line.end) { break; }
+		SplitKeyValue(line, key, value);
+		if(Equals(key, "type")) {
 			type = value;
-		} else if(key == "location") {
-			std::istringstream lineStream(value);
-			std::string xPosition, yPosition;
-			getline(lineStream, xPosition, ',');
-			getline(lineStream, yPosition, ',');
-			
+		} else if(Equals(key, "location")) {
+			// location=x,y,width,height in tiles; a missing size means one tile
+			int location[4] = {0, 0, 1, 1};
+			const char *p = value.begin;
+			for(int i=0; i < 4 && p < value.end; i++) {
+				location[i] = ParseInt(p, value.end);
+				if(p < value.end && *p == ',') {
+					p++;
+				}
+			}
 			FlareMapEntity newEntity;
-			newEntity.type = type;
-			newEntity.x = std::atoi(xPosition.c_str());
-			newEntity.y = std::atoi(yPosition.c_str());
+			newEntity.type.assign(type.begin, type.end);
+			newEntity.typeId = FindEntityType(newEntity.type);
+			newEntity.x = location[0];
+			newEntity.y = location[1];
+			newEntity.width = location[2];
+			newEntity.height = location[3];
 			entities.push_back(newEntity);
 		}
 	}
 	return true;
 }
 
-void FlareMap::Load(const std::string fileName) {
-	std::ifstream infile(fileName);
-	if(infile.fail()) {
-		assert(false); // unable to open file
+bool FlareMap::Load(const std::string fileName) {
+	// layers already held would be appended to and have no entry in explicitRoles
+	Clear();
+	MappedFile file;
+	if(!file.Open(fileName)) {
+		return false;
+	}
+	const char *cursor = (const char*)file.data;
+	const char *end = cursor + file.size;
+	std::vector<bool> explicitRoles;
+	TextRange line;
+	while(NextLine(cursor, end, line)) {
+		bool valid = true;
+		if(Equals(line, "[header]")) {
+			valid = ReadHeader(cursor, end);
+		} else if(Equals(line, "[layer]")) {
+			bool explicitRole;
+			valid = ReadLayerData(cursor, end, explicitRole);
+			explicitRoles.push_back(explicitRole);
+		} else if(Equals(line, "[ObjectsLayer]")) {
+			valid = ReadEntityData(cursor, end);
+		}
+		if(!valid) {
+			// a partly read map is worse than none
+			Clear();
+			return false;
+		}
+	}
+
+	// physics uses the first layer named or marked as collision. Maps that
+	// don't say, like our single layer levels, collide with their first
+	// unnamed layer and treat any other unnamed layer as decoration.
+	collisionLayer = -1;
+	for(size_t i=0; i < layers.size(); i++) {
+		if(explicitRoles[i] && layers[i].role == LAYER_COLLISION && collisionLayer < 0) {
+			collisionLayer = (int)i;
+		}
+	}
+	for(size_t i=0; i < layers.size(); i++) {
+		if(!explicitRoles[i] && collisionLayer < 0) {
+			layers[i].role = LAYER_COLLISION;
+			collisionLayer = (int)i;
+		}
+	}
+	return true;
+}
+
+bool FlareMap::SaveText(const std::string fileName) const {
+	if(mapWidth <= 0 || mapHeight <= 0) {
+		return false;
 	}
-	std::string line;
-	while (std::getline(infile, line)) {
-		if(line == "[header]") {
-			if(!ReadHeader(infile)) {
-				assert(false); // invalid file data
+	std::ofstream outfile(fileName);
+	if(outfile.fail()) {
+		return false;
+	}
+	outfile << "[header]\nwidth=" << mapWidth << "\nheight=" << mapHeight << "\n\n";
+	for(const FlareMapLayer &layer : layers) {
+		outfile << "[layer]\ntype=" << layer.name << "\nrole=" << ROLE_NAMES[layer.role] << "\ndata=\n";
+		for(int y=0; y < mapHeight; y++) {
+			const FlareTile *row = layer.tiles + y * mapWidth;
+			for(int x=0; x < mapWidth;) {
+				int run = 1;
+				while(x + run < mapWidth && row[x + run] == row[x]) {
+					run++;
+				}
+				if(run > 1) {
+					outfile << run << '*';
+				}
+				outfile << (row[x] != 0 ? row[x] + 1 : 0);
+				x += run;
+				if(x < mapWidth || y + 1 < mapHeight) {
+					outfile << ',';
+				}
 			}
-		} else if(line == "[layer]") {
-			ReadLayerData(infile);
-		} else if(line == "[ObjectsLayer]") {
-			ReadEntityData(infile);
+			outfile << '\n';
+		}
+		outfile << '\n';
+	}
+	for(const FlareMapEntity &entity : entities) {
+		outfile << "[ObjectsLayer]\ntype=" << entity.type << "\nlocation=" << entity.x << ',' << entity.y << ','
+			<< entity.width << ',' << entity.height << "\n\n";
+	}
+	return outfile.good();
+}
+
+bool FlareMap::LoadBinary(const std::string fileName) {
+	MappedFile *file = new MappedFile();
+	if(!file->Open(fileName) || file->size < sizeof(FlareMapFileHeader)) {
+		delete file;
+		return false;
+	}
+	const FlareMapFileHeader *header = (const FlareMapFileHeader*)file->data;
+	bool valid = memcmp(header->magic, FLARE_MAP_MAGIC, sizeof(FLARE_MAP_MAGIC)) == 0 &&
+		header->version == FLARE_MAP_VERSION &&
+		header->fileSize == file->size &&
+		header->mapWidth > 0 && header->mapHeight > 0 &&
+		header->layerOffset % sizeof(uint32_t) == 0 &&
+		header->layerOffset + (size_t)header->layerCount * sizeof(FlareMapFileLayer) <= file->size &&
+		header->entityOffset % sizeof(uint32_t) == 0 &&
+		header->entityOffset + (size_t)header->entityCount * sizeof(FlareMapFileEntity) <= file->size;
+	const FlareMapFileLayer *fileLayers = (const FlareMapFileLayer*)(file->data + header->layerOffset);
+	size_t tileCount = valid ? (size_t)header->mapWidth * header->mapHeight : 0;
+	std::vector<FlareMapLayer> loaded(valid ? header->layerCount : 0);
+	for(size_t i=0; valid && i < loaded.size(); i++) {
+		const FlareMapFileLayer &record = fileLayers[i];
+		valid = record.role <= LAYER_DECORATION && record.dataOffset + (size_t)record.dataSize <= file->size;
+		if(!valid) {
+			break;
+		}
+		loaded[i].name = std::string(record.name, strnlen(record.name, sizeof(record.name)));
+		loaded[i].role = (FlareLayerRole)record.role;
+		if(record.encoding == FLARE_ENCODING_RAW) {
+			// raw tiles are used straight out of the mapping, nothing is copied
+			valid = record.dataOffset % sizeof(FlareTile) == 0 && record.dataSize == tileCount * sizeof(FlareTile);
+			loaded[i].tiles = (const FlareTile*)(file->data + record.dataOffset);
+		} else if(record.encoding == FLARE_ENCODING_RLE) {
+			loaded[i].tileStorage.resize(tileCount);
+			valid = DecodeRLE(file->data + record.dataOffset, record.dataSize, loaded[i].tileStorage.data(), tileCount);
+			loaded[i].tiles = loaded[i].tileStorage.data();
+		} else {
+			valid = false;
+		}
+	}
+	if(!valid) {
+		delete file;	// stale or foreign file, the caller can fall back to the text map
+		return false;
+	}
+
+	Clear();
+	mapWidth = header->mapWidth;
+	mapHeight = header->mapHeight;
+	mappedFile = file;
+	layers.swap(loaded);
+	for(size_t i=0; i < layers.size(); i++) {
+		if(layers[i].role == LAYER_COLLISION && collisionLayer < 0) {
+			collisionLayer = (int)i;
+		}
+	}
+
+	const FlareMapFileEntity *fileEntities = (const FlareMapFileEntity*)(file->data + header->entityOffset);
+	entities.reserve(header->entityCount);
+	for(uint32_t i=0; i < header->entityCount; i++) {
+		entities.push_back(EntityFromFile(fileEntities[i]));
+	}
+	return true;
+}
+
+bool FlareMap::SaveBinary(const std::string fileName) const {
+	if(mapWidth <= 0 || mapHeight <= 0) {
+		return false;
+	}
+	size_t tileCount = (size_t)mapWidth * mapHeight;
+	uint32_t tileBytes = (uint32_t)(tileCount * sizeof(FlareTile));
+
+	FlareMapFileHeader header;
+	memcpy(header.magic, FLARE_MAP_MAGIC, sizeof(FLARE_MAP_MAGIC));
+	header.version = FLARE_MAP_VERSION;
+	header.mapWidth = mapWidth;
+	header.mapHeight = mapHeight;
+	header.layerCount = (uint32_t)layers.size();
+	header.layerOffset = sizeof(FlareMapFileHeader);
+	header.entityCount = (uint32_t)entities.size();
+
+	// layer data follows the layer table; each block is padded so the next stays 4 byte aligned
+	std::vector<FlareMapFileLayer> records(layers.size());
+	std::vector<std::vector<unsigned char> > encoded(layers.size());
+	uint32_t dataOffset = header.layerOffset + header.layerCount * sizeof(FlareMapFileLayer);
+	for(size_t i=0; i < layers.size(); i++) {
+		FlareMapFileLayer &record = records[i];
+		memset(&record, 0, sizeof(record));
+		if(layers[i].name.size() >= sizeof(record.name)) {
+			return false;	// names are stored inline and must leave room for a terminator
+		}
+		memcpy(record.name, layers[i].name.c_str(), layers[i].name.size());
+		record.role = layers[i].role;
+		EncodeRLE(layers[i].tiles, tileCount, encoded[i]);
+		if(encoded[i].size() < tileBytes) {
+			record.encoding = FLARE_ENCODING_RLE;
+			record.dataSize = (uint32_t)encoded[i].size();
+		} else {
+			encoded[i].clear();
+			record.encoding = FLARE_ENCODING_RAW;
+			record.dataSize = tileBytes;
+		}
+		record.dataOffset = dataOffset;
+		dataOffset += (record.dataSize + 3) & ~3u;
+	}
+	header.entityOffset = dataOffset;
+	header.fileSize = header.entityOffset + header.entityCount * sizeof(FlareMapFileEntity);
+
+	std::ofstream outfile(fileName, std::ios::binary);
+	if(outfile.fail()) {
+		return false;
+	}
+	outfile.write((const char*)&header, sizeof(header));
+	outfile.write((const char*)records.data(), records.size() * sizeof(FlareMapFileLayer));
+	const char padding[4] = {0, 0, 0, 0};
+	for(size_t i=0; i < layers.size(); i++) {
+		if(records[i].encoding == FLARE_ENCODING_RLE) {
+			outfile.write((const char*)encoded[i].data(), encoded[i].size());
+		} else {
+			outfile.write((const char*)layers[i].tiles, tileBytes);
+		}
+		outfile.write(padding, ((records[i].dataSize + 3) & ~3u) - records[i].dataSize);
+	}
+	for(const FlareMapEntity &entity : entities) {
+		FlareMapFileEntity record;
+		if(!EntityToFile(entity, record)) {
+			return false;
 		}
+		outfile.write((const char*)&record, sizeof(record));
 	}
+	return outfile.good();
 }
@@ -2,29 +2,155 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+class MappedFile;
+
+// Tile index into the sprite sheet; 0 is an empty cell.
+typedef uint16_t FlareTile;
+
+// typeId for entities whose type was never registered
+const int FLARE_UNKNOWN_TYPE = -1;
 
 struct FlareMapEntity {
 	std::string type;
+	int typeId;			// dense id from FlareMap::RegisterEntityType
 	float x;
 	float y;
+	float width;
+	float height;
+};
+
+// What a layer is used for. Every layer is drawn, but only the collision layer
+// is tested by physics. Foreground layers are drawn in front of entities, the
+// rest behind them.
+enum FlareLayerRole { LAYER_BACKGROUND, LAYER_COLLISION, LAYER_FOREGROUND, LAYER_DECORATION };
+
+// Move-only: tiles may point into the layer's own tileStorage, which a copy
+// would leave it pointing at. Moving the vector keeps its buffer.
+struct FlareMapLayer {
+	FlareMapLayer() : role(LAYER_DECORATION), tiles(nullptr) {}
+	FlareMapLayer(const FlareMapLayer &) = delete;
+	FlareMapLayer &operator=(const FlareMapLayer &) = delete;
+	FlareMapLayer(FlareMapLayer &&) noexcept = default;
+	FlareMapLayer &operator=(FlareMapLayer &&) noexcept = default;
+
+	std::string name;
+	FlareLayerRole role;
+	// row-major mapWidth * mapHeight tiles, owned by tileStorage for text maps
+	// or pointing into the mapped file for compiled ones
+	const FlareTile *tiles;
+	std::vector<FlareTile> tileStorage;
+};
+
+// How a compiled layer or world chunk stores its tiles. Raw tiles are used
+// straight out of the file; RLE data is a sequence of (run length, tile)
+// pairs, each a LEB128 varint, decoded into memory at load.
+enum FlareTileEncoding { FLARE_ENCODING_RAW, FLARE_ENCODING_RLE };
+
+// Compiled level (.flb) layout, written by the level compiler in Tools/.
+// A fixed header is followed by the layer table, each layer's tile data and
+// the entity table, all at aligned offsets so they can be read straight out
+// of the mapping.
+const char FLARE_MAP_MAGIC[4] = {'F', 'L', 'M', 'B'};
+const uint32_t FLARE_MAP_VERSION = 5;
+
+struct FlareMapFileHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t mapWidth;
+	int32_t mapHeight;
+	uint32_t layerCount;
+	uint32_t layerOffset;		// layerCount FlareMapFileLayer records
+	uint32_t entityCount;
+	uint32_t entityOffset;		// entityCount FlareMapFileEntity records
+	uint32_t fileSize;
+};
+
+struct FlareMapFileLayer {
+	char name[24];
+	uint32_t role;
+	uint32_t encoding;			// FlareTileEncoding
+	uint32_t dataOffset;		// mapWidth * mapHeight row-major FlareTiles in that encoding
+	uint32_t dataSize;
+};
+
+struct FlareMapFileEntity {
+	char type[24];
+	float x;
+	float y;
+	float width;
+	float height;
 };
 
 class FlareMap {
 	public:
 		FlareMap();
+		FlareMap(FlareMap &&other);
+		FlareMap &operator=(FlareMap &&other);
 		~FlareMap();
-	
-		void Load(const std::string fileName);
+
+		// Text maps are in Flare format; layer rows may also use count*tile
+		// tokens for runs of the same tile, which SaveText writes. Returns
+		// false, leaving the map empty, when the file can't be read or holds a
+		// malformed header or a tile that doesn't fit a FlareTile.
+		bool Load(const std::string fileName);
+		bool SaveText(const std::string fileName) const;
+		bool LoadBinary(const std::string fileName);
+		// layers are stored RLE encoded whenever that is smaller than raw tiles
+		bool SaveBinary(const std::string fileName) const;
+
+		// tile at (x, y) of a layer, or an empty tile when the cell lies outside the map
+		FlareTile GetTile(int layer, int x, int y) const {
+			if(x < 0 || y < 0 || x >= mapWidth || y >= mapHeight) {
+				return 0;
+			}
+			return layers[layer].tiles[y * mapWidth + x];
+		}
+
+		// tile physics should test at (x, y); empty when the map has no collision layer
+		FlareTile GetCollisionTile(int x, int y) const {
+			if(collisionLayer < 0) {
+				return 0;
+			}
+			return GetTile(collisionLayer, x, y);
+		}
 
 		int mapWidth;
 		int mapHeight;
-		unsigned int **mapData;
+		std::vector<FlareMapLayer> layers;
+		int collisionLayer;
 		std::vector<FlareMapEntity> entities;
-	
+
+		// threads used to decode large text layers, 0 picks one per core
+		static unsigned int parseThreads;
+
+		// Entity type names get small dense ids as maps load, so spawning can
+		// index a table instead of comparing strings. Register every type
+		// before loading maps (lookups during a load never modify the table);
+		// registering a name twice returns its existing id.
+		static int RegisterEntityType(const std::string &type);
+		static int FindEntityType(const std::string &type);
+
+		// conversions to and from the inline entity records of compiled maps
+		static FlareMapEntity EntityFromFile(const FlareMapFileEntity &record);
+		static bool EntityToFile(const FlareMapEntity &entity, FlareMapFileEntity &record);
+
+		// FLARE_ENCODING_RLE tile data; decoding fails unless the data fills
+		// exactly count tiles
+		static void EncodeRLE(const FlareTile *tiles, size_t count, std::vector<unsigned char> &out);
+		static bool DecodeRLE(const unsigned char *data, size_t size, FlareTile *tiles, size_t count);
+
 	private:
-	
-		bool ReadHeader(std::ifstream &stream);
-		bool ReadLayerData(std::ifstream &stream);
-		bool ReadEntityData(std::ifstream &stream);
-	
+		FlareMap(const FlareMap &) = delete;
+		FlareMap &operator=(const FlareMap &) = delete;
+		void Clear();
+
+		bool ReadHeader(const char *&cursor, const char *end);
+		bool ReadLayerData(const char *&cursor, const char *end, bool &explicitRole);
+		bool ReadEntityData(const char *&cursor, const char *end);
+
+		MappedFile *mappedFile;
+		static std::unordered_map<std::string, int> entityTypeIds;
 };
@@ -0,0 +1,127 @@
+#include "InstancedSpriteBatch.h"
+#include "RenderDevice.h"
+#include <SDL.h>
+#include "glm/mat4x4.hpp"
+
+InstancedSpriteBatch::InstancedSpriteBatch() : supported(false), drawCalls(0), spriteCount(0), usedBatches(0), lastBatch(0),
+    instanceTransformAttribute(-1), instanceTexRectAttribute(-1), quadBuffer(0),
+    vertexAttribDivisor(nullptr), drawArraysInstanced(nullptr) {}
+
+bool InstancedSpriteBatch::Setup(ShaderProgram &p) {
+    instanceTransformAttribute = glGetAttribLocation(p.programID, "instanceTransform");
+    instanceTexRectAttribute = glGetAttribLocation(p.programID, "instanceTexRect");
+    ResetInstanceAttributes();
+
+    supported = false;
+    if (instanceTransformAttribute < 0 || instanceTexRectAttribute < 0 ||
+        !SDL_GL_ExtensionSupported("GL_ARB_instanced_arrays") || !SDL_GL_ExtensionSupported("GL_ARB_draw_instanced")) {
+        return false;
+    }
+    vertexAttribDivisor = (VertexAttribDivisorFunc)SDL_GL_GetProcAddress("glVertexAttribDivisorARB");
+    drawArraysInstanced = (DrawArraysInstancedFunc)SDL_GL_GetProcAddress("glDrawArraysInstancedARB");
+    if (vertexAttribDivisor == nullptr || drawArraysInstanced == nullptr) {
+        return false;
+    }
+
+    // the unit quad SheetSprite always drew, texture coordinates as fractions of the UV rect
+    GLfloat quad[] = {
+        -0.5f, -0.5f, 0.0f, 1.0f,
+        0.5f, 0.5f, 1.0f, 0.0f,
+        -0.5f, 0.5f, 0.0f, 0.0f,
+        0.5f, 0.5f, 1.0f, 0.0f,
+        -0.5f, -0.5f, 0.0f, 1.0f,
+        0.5f, -0.5f, 1.0f, 1.0f
+    };
+    glGenBuffers(1, &quadBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    supported = true;
+    return true;
+}
+
+void InstancedSpriteBatch::Draw(GLuint textureID, float x, float y, float scaleX, float scaleY, float u, float v, float width, float height) {
+    if (lastBatch >= usedBatches || batches[lastBatch].textureID != textureID) {
+        lastBatch = 0;
+        while (lastBatch < usedBatches && batches[lastBatch].textureID != textureID) {
+            lastBatch++;
+        }
+        if (lastBatch == usedBatches) {
+            if (usedBatches == batches.size()) {
+                batches.push_back(Batch());
+            }
+            batches[usedBatches].textureID = textureID;
+            batches[usedBatches].instances.clear();
+            usedBatches++;
+        }
+    }
+    batches[lastBatch].instances.insert(batches[lastBatch].instances.end(), {x, y, scaleX, scaleY, u, v, width, height});
+}
+
+void InstancedSpriteBatch::Flush(ShaderProgram &p) {
+    drawCalls = 0;
+    spriteCount = 0;
+    if (usedBatches == 0) {
+        return;
+    }
+    p.SetModelMatrix(glm::mat4(1.0f));
+    glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+    glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)0);
+    glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(p.positionAttribute);
+    glEnableVertexAttribArray(p.texCoordAttribute);
+
+    glEnableVertexAttribArray(instanceTransformAttribute);
+    glEnableVertexAttribArray(instanceTexRectAttribute);
+    vertexAttribDivisor(instanceTransformAttribute, 1);
+    vertexAttribDivisor(instanceTexRectAttribute, 1);
+
+    for (size_t i = 0; i < usedBatches; i++) {
+        std::vector<float> &instances = batches[i].instances;
+        // GL 2.1 has no base instance, so the pointers move to each batch's records
+        size_t offset;
+        GLuint buffer = RenderDevice::current->StreamVertices(instances.data(), instances.size() * sizeof(float), &offset);
+        const char *base = (const char*)offset;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexAttribPointer(instanceTransformAttribute, 4, GL_FLOAT, false, 8 * sizeof(float), base);
+        glVertexAttribPointer(instanceTexRectAttribute, 4, GL_FLOAT, false, 8 * sizeof(float), base + 4 * sizeof(float));
+        glBindTexture(GL_TEXTURE_2D, batches[i].textureID);
+        drawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)(instances.size() / 8));
+        drawCalls++;
+        spriteCount += (int)(instances.size() / 8);
+        instances.clear();
+    }
+
+    vertexAttribDivisor(instanceTransformAttribute, 0);
+    vertexAttribDivisor(instanceTexRectAttribute, 0);
+    glDisableVertexAttribArray(instanceTransformAttribute);
+    glDisableVertexAttribArray(instanceTexRectAttribute);
+    glDisableVertexAttribArray(p.positionAttribute);
+    glDisableVertexAttribArray(p.texCoordAttribute);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ResetInstanceAttributes();
+    usedBatches = 0;
+    lastBatch = 0;
+}
+
+// Drawing from an attribute array leaves its constant value undefined, so
+// this runs after every instanced flush as well as in Setup.
+void InstancedSpriteBatch::ResetInstanceAttributes() {
+    if (instanceTransformAttribute >= 0) {
+        glVertexAttrib4f(instanceTransformAttribute, 0.0f, 0.0f, 1.0f, 1.0f);
+    }
+    if (instanceTexRectAttribute >= 0) {
+        glVertexAttrib4f(instanceTexRectAttribute, 0.0f, 0.0f, 1.0f, 1.0f);
+    }
+}
+
+void InstancedSpriteBatch::Cleanup() {
+    if (quadBuffer != 0) {
+        glDeleteBuffers(1, &quadBuffer);
+        quadBuffer = 0;
+    }
+    batches.clear();
+    usedBatches = 0;
+    lastBatch = 0;
+    supported = false;
+}
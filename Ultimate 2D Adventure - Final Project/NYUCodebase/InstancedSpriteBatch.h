@@ -0,0 +1,60 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <vector>
+#include "ShaderProgram.h"
+
+// Draws axis-aligned sheet sprites by instancing one shared unit quad. Each
+// sprite costs a single 8-float instance record (position, scale and UV
+// rect) which vertex_textured.glsl applies, instead of six expanded
+// vertices; the records are written to the render device's vertex stream.
+// Needs GL_ARB_instanced_arrays and GL_ARB_draw_instanced; when Setup
+// finds them missing, supported stays false and callers should use
+// SpriteBatch instead.
+class InstancedSpriteBatch {
+    public:
+        InstancedSpriteBatch();
+
+        // Looks up the instance attributes of p and the instancing entry
+        // points and creates the quad buffer. Always call it once the context
+        // exists: it also sets the instance attributes' constant values to
+        // identity, which non-instanced draws with p rely on.
+        bool Setup(ShaderProgram &p);
+
+        // Queues a sprite of size (scaleX, scaleY) centred on (x, y), showing
+        // the sheet cell at (u, v) of size (width, height).
+        void Draw(GLuint textureID, float x, float y, float scaleX, float scaleY, float u, float v, float width, float height);
+
+        // draws and empties every queued batch, one instanced call per texture
+        void Flush(ShaderProgram &p);
+        void Cleanup();
+
+        bool supported;
+
+        // draw calls and sprites issued by the last flush
+        int drawCalls;
+        int spriteCount;
+
+    private:
+        typedef void (APIENTRY *VertexAttribDivisorFunc)(GLuint index, GLuint divisor);
+        typedef void (APIENTRY *DrawArraysInstancedFunc)(GLenum mode, GLint first, GLsizei count, GLsizei primcount);
+
+        void ResetInstanceAttributes();
+
+        struct Batch {
+            GLuint textureID;
+            std::vector<float> instances;   // x, y, scaleX, scaleY, u, v, width, height per sprite
+        };
+        std::vector<Batch> batches;
+        size_t usedBatches;
+        size_t lastBatch;
+
+        GLint instanceTransformAttribute;
+        GLint instanceTexRectAttribute;
+        GLuint quadBuffer;
+        VertexAttribDivisorFunc vertexAttribDivisor;
+        DrawArraysInstancedFunc drawArraysInstanced;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The contents stay valid until
+// Close() is called or the object is destroyed.
+class MappedFile {
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool Open(const std::string &fileName);
+		void Close();
+
+		const unsigned char *data;
+		size_t size;
+
+	private:
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+#ifdef _WINDOWS
+		void *fileHandle;
+		void *mappingHandle;
+#else
+		int fileDescriptor;
+#endif
+};
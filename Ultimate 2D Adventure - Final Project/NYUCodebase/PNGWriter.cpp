@@ -0,0 +1,84 @@
+#include "PNGWriter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <zlib.h>
+
+namespace {
+
+void AppendChunk(std::vector<unsigned char> &png, const char *type, const std::vector<unsigned char> &data) {
+    unsigned char header[8] = {(unsigned char)(data.size() >> 24), (unsigned char)(data.size() >> 16),
+                               (unsigned char)(data.size() >> 8), (unsigned char)data.size(),
+                               (unsigned char)type[0], (unsigned char)type[1], (unsigned char)type[2], (unsigned char)type[3]};
+    png.insert(png.end(), header, header + 8);
+    png.insert(png.end(), data.begin(), data.end());
+    uLong crc = crc32(0L, header + 4, 4);
+    crc = crc32(crc, data.data(), (uInt)data.size());
+    unsigned char footer[4] = {(unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc};
+    png.insert(png.end(), footer, footer + 4);
+}
+
+}
+
+bool WritePNG(const std::string &fileName, const std::vector<unsigned char> &pixels, int width, int height) {
+    size_t stride = width * 4;
+    std::vector<unsigned char> filtered;
+    filtered.reserve((stride + 1) * height);
+    std::vector<unsigned char> candidate(stride);
+    std::vector<unsigned char> best(stride);
+    for (int y = 0; y < height; y++) {
+        const unsigned char *row = &pixels[y * stride];
+        const unsigned char *above = y > 0 ? row - stride : NULL;
+        long bestScore = -1;
+        unsigned char bestFilter = 0;
+        for (unsigned char filter = 0; filter < 5; filter++) {
+            long score = 0;
+            for (size_t i = 0; i < stride; i++) {
+                int left = i >= 4 ? row[i - 4] : 0;
+                int up = above ? above[i] : 0;
+                int upLeft = above && i >= 4 ? above[i - 4] : 0;
+                int predicted = 0;
+                switch (filter) {
+                    case 1: predicted = left; break;
+                    case 2: predicted = up; break;
+                    case 3: predicted = (left + up) / 2; break;
+                    case 4: {
+                        int p = left + up - upLeft;
+                        int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - upLeft);
+                        predicted = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+                        break;
+                    }
+                }
+                candidate[i] = (unsigned char)(row[i] - predicted);
+                score += candidate[i] < 128 ? candidate[i] : 256 - candidate[i];
+            }
+            if (bestScore < 0 || score < bestScore) {
+                bestScore = score;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        filtered.push_back(bestFilter);
+        filtered.insert(filtered.end(), best.begin(), best.end());
+    }
+    uLongf compressedSize = compressBound((uLong)filtered.size());
+    std::vector<unsigned char> compressed(compressedSize);
+    if (compress2(compressed.data(), &compressedSize, filtered.data(), (uLong)filtered.size(), 9) != Z_OK) {
+        return false;
+    }
+    compressed.resize(compressedSize);
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<unsigned char> header = {(unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+                                         (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+                                         8, 6, 0, 0, 0};    // 8 bits per channel, RGBA, no interlacing
+    AppendChunk(png, "IHDR", header);
+    AppendChunk(png, "IDAT", compressed);
+    AppendChunk(png, "IEND", std::vector<unsigned char>());
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool written = fwrite(png.data(), 1, png.size(), file) == png.size();
+    fclose(file);
+    return written;
+}
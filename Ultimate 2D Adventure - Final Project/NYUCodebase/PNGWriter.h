@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Writes 8 bit RGBA pixels, top row first, as a zlib compressed PNG. Each
+// row goes through whichever PNG filter leaves the smallest residuals, which
+// keeps flat game art and rendered frames small. Used by Tools/AtlasPacker.cpp
+// for atlases and by --render-golden for its reference frames.
+bool WritePNG(const std::string &fileName, const std::vector<unsigned char> &pixels, int width, int height);
@@ -0,0 +1,303 @@
+#include "RenderDevice.h"
+#include "CookedTexture.h"
+
+OpenGLRenderDevice openGLDevice;
+RenderDevice *RenderDevice::current = &openGLDevice;
+
+OpenGLRenderDevice::OpenGLRenderDevice() : quadIndices(0), boundProgram(nullptr), boundFormat(VERTEX_FLOAT) {}
+
+void OpenGLRenderDevice::BeginFrame() {
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void OpenGLRenderDevice::EndFrame() {
+    stream.EndFrame();
+}
+
+void OpenGLRenderDevice::Cleanup() {
+    stream.Cleanup();
+    if (quadIndices != 0) {
+        glDeleteBuffers(1, &quadIndices);
+        quadIndices = 0;
+    }
+}
+
+GLuint OpenGLRenderDevice::CreateBuffer() {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    return buffer;
+}
+
+void OpenGLRenderDevice::UploadBuffer(GLuint buffer, const void *data, size_t bytes, bool dynamic) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, bytes, data, dynamic ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OpenGLRenderDevice::DeleteBuffer(GLuint buffer) {
+    glDeleteBuffers(1, &buffer);
+}
+
+GLuint OpenGLRenderDevice::StreamVertices(const void *data, size_t bytes, size_t *offset) {
+    return stream.Write(data, bytes, offset);
+}
+
+GLuint OpenGLRenderDevice::CreateTexture(const unsigned char *rgba, int width, int height, bool linear, int levels) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int level = 0; level < levels; level++) {
+        int levelWidth = CookedLevelSize(width, level), levelHeight = CookedLevelSize(height, level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        rgba += (size_t)levelWidth * levelHeight * 4;
+    }
+    if (levels > 1) {
+        // the chain may stop short of 1x1, so tell GL where it ends
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linear ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_NEAREST);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+    return texture;
+}
+
+void OpenGLRenderDevice::DeleteTexture(GLuint texture) {
+    glDeleteTextures(1, &texture);
+}
+
+void OpenGLRenderDevice::UseProgram(ShaderProgram &program) {
+    program.Use();
+}
+
+void OpenGLRenderDevice::SetModelMatrix(ShaderProgram &program, const glm::mat4 &matrix) {
+    program.SetModelMatrix(matrix);
+}
+
+void OpenGLRenderDevice::SetViewMatrix(ShaderProgram &program, const glm::mat4 &matrix) {
+    program.SetViewMatrix(matrix);
+}
+
+void OpenGLRenderDevice::SetProjectionMatrix(ShaderProgram &program, const glm::mat4 &matrix) {
+    program.SetProjectionMatrix(matrix);
+}
+
+void OpenGLRenderDevice::BindTexture(GLuint textureID) {
+    glBindTexture(GL_TEXTURE_2D, textureID);
+}
+
+void OpenGLRenderDevice::BindVertices(ShaderProgram &program, GLuint buffer, VertexFormat format) {
+    boundProgram = &program;
+    boundFormat = format;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(program.positionAttribute);
+    glEnableVertexAttribArray(program.texCoordAttribute);
+    PointAttributes(0);
+}
+
+void OpenGLRenderDevice::PointAttributes(size_t firstVertex) {
+    ShaderProgram &program = *boundProgram;
+    if (boundFormat == VERTEX_PACKED) {
+        const char *base = (const char*)(firstVertex * sizeof(PackedVertex));
+        glVertexAttribPointer(program.positionAttribute, 2, GL_SHORT, false, sizeof(PackedVertex), base);
+        // normalized, so the shader sees them back in 0-1
+        glVertexAttribPointer(program.texCoordAttribute, 2, GL_UNSIGNED_SHORT, true, sizeof(PackedVertex), base + 2 * sizeof(int16_t));
+    } else {
+        const char *base = (const char*)(firstVertex * 4 * sizeof(float));
+        glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), base);
+        glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), base + 2 * sizeof(float));
+    }
+}
+
+void OpenGLRenderDevice::UnbindVertices(ShaderProgram &program) {
+    glDisableVertexAttribArray(program.positionAttribute);
+    glDisableVertexAttribArray(program.texCoordAttribute);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void OpenGLRenderDevice::DrawTriangles(GLint firstVertex, GLsizei vertexCount) {
+    glDrawArrays(GL_TRIANGLES, firstVertex, vertexCount);
+}
+
+void OpenGLRenderDevice::DrawQuads(GLint firstQuad, GLsizei quadCount) {
+    if (quadIndices == 0) {
+        std::vector<GLushort> indices;
+        indices.reserve(MAX_INDEXED_QUADS * 6);
+        for (int quad = 0; quad < MAX_INDEXED_QUADS; quad++) {
+            GLushort corner = (GLushort)(quad * 4);
+            indices.insert(indices.end(), {corner, (GLushort)(corner + 1), (GLushort)(corner + 2),
+                                           corner, (GLushort)(corner + 2), (GLushort)(corner + 3)});
+        }
+        glGenBuffers(1, &quadIndices);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndices);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndices);
+    // 16-bit indices only reach MAX_INDEXED_QUADS quads past the attribute
+    // pointers, and GL 2.1 has no base vertex, so longer runs move the
+    // pointers along for each batch
+    bool moved = false;
+    while (quadCount > 0) {
+        GLsizei batch = quadCount < MAX_INDEXED_QUADS ? quadCount : MAX_INDEXED_QUADS;
+        if (firstQuad + batch > MAX_INDEXED_QUADS) {
+            PointAttributes((size_t)firstQuad * 4);
+            glDrawElements(GL_TRIANGLES, batch * 6, GL_UNSIGNED_SHORT, (const void*)0);
+            moved = true;
+        } else {
+            glDrawElements(GL_TRIANGLES, batch * 6, GL_UNSIGNED_SHORT, (const void*)(firstQuad * 6 * sizeof(GLushort)));
+        }
+        firstQuad += batch;
+        quadCount -= batch;
+    }
+    if (moved) {
+        PointAttributes(0);
+    }
+}
+
+RenderFrameLog::RenderFrameLog() : drawCalls(0), programChanges(0), uniformUploads(0), textureBinds(0), bufferUploads(0),
+    uploadedBytes(0), drawnVertexBytes(0) {}
+
+RecordingRenderDevice::RecordingRenderDevice() : frames(1), recordEvents(true), liveBuffers(0), nextBuffer(1), nextTexture(1),
+    streamBuffer(0), streamBytes(0), program(nullptr), boundBuffer(0), inFrame(false) {}
+
+void RecordingRenderDevice::BeginFrame() {
+    frames.push_back(RenderFrameLog());
+    inFrame = true;
+}
+
+void RecordingRenderDevice::EndFrame() {
+    inFrame = false;
+    streamBytes = 0;
+}
+
+const RenderFrameLog &RecordingRenderDevice::LastFrame() const {
+    return frames.back();
+}
+
+void RecordingRenderDevice::Record(RenderEventType type, GLuint id, size_t bytes, GLint firstVertex, GLsizei vertexCount) {
+    RenderFrameLog &frame = inFrame ? frames.back() : frames[0];
+    switch (type) {
+        case RENDER_EVENT_UPLOAD:
+            frame.bufferUploads++;
+            frame.uploadedBytes += bytes;
+            break;
+        case RENDER_EVENT_PROGRAM:
+            frame.programChanges++;
+            break;
+        case RENDER_EVENT_UNIFORM:
+            frame.uniformUploads++;
+            break;
+        case RENDER_EVENT_TEXTURE:
+            frame.textureBinds++;
+            break;
+        case RENDER_EVENT_VERTICES:
+            break;
+        case RENDER_EVENT_DRAW:
+            frame.drawCalls++;
+            frame.drawnVertexBytes += bytes;
+            break;
+    }
+    if (recordEvents) {
+        RenderEvent event = {type, id, bytes, firstVertex, vertexCount};
+        frame.events.push_back(event);
+    }
+}
+
+GLuint RecordingRenderDevice::CreateBuffer() {
+    bufferSizes[nextBuffer] = 0;
+    liveBuffers++;
+    return nextBuffer++;
+}
+
+void RecordingRenderDevice::UploadBuffer(GLuint buffer, const void *data, size_t bytes, bool dynamic) {
+    bufferSizes[buffer] = bytes;
+    Record(RENDER_EVENT_UPLOAD, buffer, bytes);
+}
+
+void RecordingRenderDevice::DeleteBuffer(GLuint buffer) {
+    if (bufferSizes.erase(buffer) > 0) {
+        liveBuffers--;
+    }
+}
+
+// The stream belongs to the device, so it is left out of liveBuffers.
+GLuint RecordingRenderDevice::StreamVertices(const void *data, size_t bytes, size_t *offset) {
+    if (streamBuffer == 0) {
+        streamBuffer = nextBuffer++;
+    }
+    *offset = (streamBytes + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+    streamBytes = *offset + bytes;
+    Record(RENDER_EVENT_UPLOAD, streamBuffer, bytes);
+    return streamBuffer;
+}
+
+GLuint RecordingRenderDevice::CreateTexture(const unsigned char *rgba, int width, int height, bool linear, int levels) {
+    Record(RENDER_EVENT_UPLOAD, nextTexture, CookedTexelBytes(width, height, levels));
+    return nextTexture++;
+}
+
+void RecordingRenderDevice::DeleteTexture(GLuint texture) {
+    // only texture uploads are recorded
+}
+
+void RecordingRenderDevice::UseProgram(ShaderProgram &next) {
+    if (program == &next) {
+        ShaderProgram::skippedBinds++;
+        return;
+    }
+    program = &next;
+    Record(RENDER_EVENT_PROGRAM, next.programID);
+}
+
+void RecordingRenderDevice::SetModelMatrix(ShaderProgram &target, const glm::mat4 &matrix) {
+    std::map<const ShaderProgram*, glm::mat4>::iterator found = modelMatrices.find(&target);
+    if (found != modelMatrices.end() && found->second == matrix) {
+        ShaderProgram::skippedBinds++;
+        ShaderProgram::skippedUploads++;
+        return;
+    }
+    modelMatrices[&target] = matrix;
+    Record(RENDER_EVENT_UNIFORM, target.programID);
+}
+
+void RecordingRenderDevice::SetViewMatrix(ShaderProgram &target, const glm::mat4 &matrix) {
+    std::map<const ShaderProgram*, glm::mat4>::iterator found = viewMatrices.find(&target);
+    if (found != viewMatrices.end() && found->second == matrix) {
+        ShaderProgram::skippedBinds++;
+        ShaderProgram::skippedUploads++;
+        return;
+    }
+    viewMatrices[&target] = matrix;
+    Record(RENDER_EVENT_UNIFORM, target.programID);
+}
+
+void RecordingRenderDevice::SetProjectionMatrix(ShaderProgram &target, const glm::mat4 &matrix) {
+    std::map<const ShaderProgram*, glm::mat4>::iterator found = projectionMatrices.find(&target);
+    if (found != projectionMatrices.end() && found->second == matrix) {
+        ShaderProgram::skippedBinds++;
+        ShaderProgram::skippedUploads++;
+        return;
+    }
+    projectionMatrices[&target] = matrix;
+    Record(RENDER_EVENT_UNIFORM, target.programID);
+}
+
+void RecordingRenderDevice::BindTexture(GLuint textureID) {
+    Record(RENDER_EVENT_TEXTURE, textureID);
+}
+
+void RecordingRenderDevice::BindVertices(ShaderProgram &target, GLuint buffer, VertexFormat format) {
+    boundBuffer = buffer;
+    Record(RENDER_EVENT_VERTICES, buffer);
+}
+
+void RecordingRenderDevice::UnbindVertices(ShaderProgram &target) {}
+
+void RecordingRenderDevice::DrawTriangles(GLint firstVertex, GLsizei vertexCount) {
+    Record(RENDER_EVENT_DRAW, boundBuffer, vertexCount * 4 * sizeof(float), firstVertex, vertexCount);
+}
+
+void RecordingRenderDevice::DrawQuads(GLint firstQuad, GLsizei quadCount) {
+    Record(RENDER_EVENT_DRAW, boundBuffer, quadCount * (4 * sizeof(PackedVertex) + 6 * sizeof(GLushort)), firstQuad * 4, quadCount * 4);
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <vector>
+#include <map>
+#include <cstddef>
+#include <cstdint>
+#include "ShaderProgram.h"
+#include "StreamRing.h"
+#include "glm/mat4x4.hpp"
+
+// A corner of a tile or text quad. Positions are whole mesh units, which
+// the model matrix scales into the world; texture coordinates are 65535ths,
+// which GL normalizes back to 0-1 before vertex_textured.glsl sees them.
+// Four of these and the shared quad indices replace six float vertices.
+struct PackedVertex {
+    int16_t x, y;
+    uint16_t u, v;
+};
+
+const float PACKED_TEXCOORD_SCALE = 1.0f / 65535.0f;
+
+// t in 0-1, rounded to the nearest 65535th
+inline uint16_t PackTexCoord(float t) {
+    return (uint16_t)(t <= 0.0f ? 0.0f : (t >= 1.0f ? 65535.0f : t * 65535.0f + 0.5f));
+}
+
+// quads one draw can reach through the shared quad index buffer, the most
+// 16-bit indices can address
+const int MAX_INDEXED_QUADS = 16384;
+
+enum VertexFormat {
+    VERTEX_FLOAT,       // x, y, u, v floats drawn as triangles by DrawTriangles
+    VERTEX_PACKED       // PackedVertex quads drawn by DrawQuads
+};
+
+// The GL calls the render queue and the mesh classes make, behind an
+// interface so rendering can run without a GL context.
+class RenderDevice {
+    public:
+        virtual ~RenderDevice() {}
+
+        virtual void BeginFrame() = 0;      // clears the screen
+        virtual void EndFrame() = 0;
+
+        virtual GLuint CreateBuffer() = 0;
+        // dynamic data is replaced every frame, static data is kept
+        virtual void UploadBuffer(GLuint buffer, const void *data, size_t bytes, bool dynamic) = 0;
+        virtual void DeleteBuffer(GLuint buffer) = 0;
+        // Copies vertices written this frame into the device's stream and
+        // returns the buffer holding them, with their byte offset in
+        // *offset, a multiple of STREAM_ALIGNMENT. They stay valid until
+        // EndFrame.
+        virtual GLuint StreamVertices(const void *data, size_t bytes, size_t *offset) = 0;
+        // rgba is width * height RGBA8 texels, top row first, followed by
+        // levels - 1 mip levels each half the size of the one before (see
+        // CookedLevelSize); linear picks bilinear filtering over nearest
+        virtual GLuint CreateTexture(const unsigned char *rgba, int width, int height, bool linear, int levels) = 0;
+        virtual void DeleteTexture(GLuint texture) = 0;
+
+        virtual void UseProgram(ShaderProgram &program) = 0;
+        virtual void SetModelMatrix(ShaderProgram &program, const glm::mat4 &matrix) = 0;
+        virtual void SetViewMatrix(ShaderProgram &program, const glm::mat4 &matrix) = 0;
+        virtual void SetProjectionMatrix(ShaderProgram &program, const glm::mat4 &matrix) = 0;
+        virtual void BindTexture(GLuint textureID) = 0;
+        // points program's position and texCoord attributes at buffer, laid out as format
+        virtual void BindVertices(ShaderProgram &program, GLuint buffer, VertexFormat format) = 0;
+        virtual void UnbindVertices(ShaderProgram &program) = 0;
+        virtual void DrawTriangles(GLint firstVertex, GLsizei vertexCount) = 0;
+        // Draws quads of four packed corners each, top left, bottom left,
+        // bottom right, top right, split along the top left to bottom right
+        // diagonal.
+        virtual void DrawQuads(GLint firstQuad, GLsizei quadCount) = 0;
+
+        // The device everything renders through: an OpenGL device unless
+        // something such as a headless run swaps in another.
+        static RenderDevice *current;
+};
+
+class OpenGLRenderDevice : public RenderDevice {
+    public:
+        OpenGLRenderDevice();
+        // frees the stream and the quad indices; call before the context goes
+        void Cleanup();
+
+        void BeginFrame();
+        void EndFrame();
+        GLuint CreateBuffer();
+        void UploadBuffer(GLuint buffer, const void *data, size_t bytes, bool dynamic);
+        void DeleteBuffer(GLuint buffer);
+        GLuint StreamVertices(const void *data, size_t bytes, size_t *offset);
+        GLuint CreateTexture(const unsigned char *rgba, int width, int height, bool linear, int levels);
+        void DeleteTexture(GLuint texture);
+        void UseProgram(ShaderProgram &program);
+        void SetModelMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void SetViewMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void SetProjectionMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void BindTexture(GLuint textureID);
+        void BindVertices(ShaderProgram &program, GLuint buffer, VertexFormat format);
+        void UnbindVertices(ShaderProgram &program);
+        void DrawTriangles(GLint firstVertex, GLsizei vertexCount);
+        void DrawQuads(GLint firstQuad, GLsizei quadCount);
+
+        StreamRing stream;          // every frame's dynamic vertices
+
+    private:
+        void PointAttributes(size_t firstVertex);
+
+        GLuint quadIndices;         // the shared index buffer, made on the first DrawQuads
+        ShaderProgram *boundProgram;
+        VertexFormat boundFormat;
+};
+
+// the device RenderDevice::current starts as
+extern OpenGLRenderDevice openGLDevice;
+
+enum RenderEventType { RENDER_EVENT_UPLOAD, RENDER_EVENT_PROGRAM, RENDER_EVENT_UNIFORM, RENDER_EVENT_TEXTURE,
+                       RENDER_EVENT_VERTICES, RENDER_EVENT_DRAW };
+
+struct RenderEvent {
+    RenderEventType type;
+    GLuint id;              // buffer, texture or program, depending on type; draws name their vertex buffer
+    size_t bytes;           // uploaded bytes, or vertex bytes a draw read
+    GLint firstVertex;
+    GLsizei vertexCount;
+};
+
+// Everything recorded between a BeginFrame and its EndFrame.
+struct RenderFrameLog {
+    RenderFrameLog();
+
+    std::vector<RenderEvent> events;
+    int drawCalls;
+    int programChanges;
+    int uniformUploads;
+    int textureBinds;
+    int bufferUploads;
+    size_t uploadedBytes;
+    size_t drawnVertexBytes;    // quad indices included
+};
+
+// Records what would have been sent to GL instead of sending it. Uniform
+// uploads and program changes that set the value already held are not
+// recorded but counted in ShaderProgram's skipped counters, matching what
+// ShaderProgram skips. Work done outside a frame, such as building level
+// meshes, is logged to frames[0].
+class RecordingRenderDevice : public RenderDevice {
+    public:
+        RecordingRenderDevice();
+
+        void BeginFrame();
+        void EndFrame();
+        GLuint CreateBuffer();
+        void UploadBuffer(GLuint buffer, const void *data, size_t bytes, bool dynamic);
+        void DeleteBuffer(GLuint buffer);
+        GLuint StreamVertices(const void *data, size_t bytes, size_t *offset);
+        GLuint CreateTexture(const unsigned char *rgba, int width, int height, bool linear, int levels);
+        void DeleteTexture(GLuint texture);
+        void UseProgram(ShaderProgram &program);
+        void SetModelMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void SetViewMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void SetProjectionMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void BindTexture(GLuint textureID);
+        void BindVertices(ShaderProgram &program, GLuint buffer, VertexFormat format);
+        void UnbindVertices(ShaderProgram &program);
+        void DrawTriangles(GLint firstVertex, GLsizei vertexCount);
+        void DrawQuads(GLint firstQuad, GLsizei quadCount);
+
+        // the most recently finished frame
+        const RenderFrameLog &LastFrame() const;
+
+        std::vector<RenderFrameLog> frames;
+        bool recordEvents;      // counters only when false, for long runs
+        size_t liveBuffers;
+
+    private:
+        void Record(RenderEventType type, GLuint id, size_t bytes = 0, GLint firstVertex = 0, GLsizei vertexCount = 0);
+
+        GLuint nextBuffer;
+        GLuint nextTexture;
+        std::map<GLuint, size_t> bufferSizes;
+        GLuint streamBuffer;
+        size_t streamBytes;         // written to the stream this frame
+        const ShaderProgram *program;
+        GLuint boundBuffer;
+        std::map<const ShaderProgram*, glm::mat4> modelMatrices;
+        std::map<const ShaderProgram*, glm::mat4> viewMatrices;
+        std::map<const ShaderProgram*, glm::mat4> projectionMatrices;
+        bool inFrame;
+};
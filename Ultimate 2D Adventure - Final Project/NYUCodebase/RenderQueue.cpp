@@ -0,0 +1,183 @@
+#include "RenderQueue.h"
+#include "RenderDevice.h"
+#include <cstring>
+
+uint64_t RenderSortKey(unsigned int layer, GLuint programID, GLuint textureID, float depth) {
+    // flip float bits so that unsigned comparison orders them like the floats
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+    depthBits = (depthBits & 0x80000000u) ? ~depthBits : depthBits | 0x80000000u;
+    return ((uint64_t)(layer & 0xFF) << 56) | ((uint64_t)(programID & 0xFF) << 48) |
+           ((uint64_t)(textureID & 0xFFFF) << 32) | depthBits;
+}
+
+RenderQueue::RenderQueue() : programChanges(0), textureChanges(0), drawCalls(0) {}
+
+void RenderQueue::Submit(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                         GLuint vertexBuffer, GLsizei vertexCount, GLint firstVertex) {
+    if (vertexCount <= 0) {
+        return;
+    }
+    RenderCommand command;
+    command.key = key;
+    command.program = &program;
+    command.textureID = textureID;
+    command.modelMatrix = modelMatrix;
+    command.vertexBuffer = vertexBuffer;
+    command.format = VERTEX_FLOAT;
+    command.firstVertex = firstVertex;
+    command.vertexCount = vertexCount;
+    commands.push_back(command);
+}
+
+void RenderQueue::SubmitQuads(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                              GLuint vertexBuffer, GLsizei quadCount, GLint firstQuad) {
+    Submit(key, program, textureID, modelMatrix, vertexBuffer, quadCount, firstQuad);
+    if (quadCount > 0) {
+        commands.back().format = VERTEX_PACKED;
+    }
+}
+
+void RenderQueue::SubmitVertices(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                                 const float *vertices, GLsizei vertexCount) {
+    if (vertexCount <= 0) {
+        return;
+    }
+    GLint first = (GLint)(streamVertices.size() / 4);
+    streamVertices.insert(streamVertices.end(), vertices, vertices + vertexCount * 4);
+    Submit(key, program, textureID, modelMatrix, 0, vertexCount, first);
+}
+
+void RenderQueue::SubmitCustom(uint64_t key, ShaderProgram &program, std::function<void()> draw) {
+    RenderCommand command;
+    command.key = key;
+    command.program = &program;
+    command.textureID = 0;
+    command.vertexBuffer = 0;
+    command.format = VERTEX_FLOAT;
+    command.firstVertex = 0;
+    command.vertexCount = 0;
+    command.custom = draw;
+    commands.push_back(command);
+}
+
+void RenderQueue::ReleaseBuffer(GLuint buffer) {
+    if (buffer != 0) {
+        releasedBuffers.push_back(buffer);
+    }
+}
+
+// Least significant digit radix sort of the command indices, a byte per
+// pass. It is stable, so equal keys keep their submission order, and passes
+// over bytes every key shares are skipped.
+void RenderQueue::Sort() {
+    size_t count = commands.size();
+    order.resize(count);
+    scratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = (uint32_t)i;
+    }
+    size_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = commands[i].key;
+        for (int pass = 0; pass < 8; pass++) {
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+    for (int pass = 0; pass < 8; pass++) {
+        size_t *histogram = histograms[pass];
+        if (histogram[(commands[0].key >> (pass * 8)) & 0xFF] == count) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t index = order[i];
+            scratch[histogram[(commands[index].key >> (pass * 8)) & 0xFF]++] = index;
+        }
+        order.swap(scratch);
+    }
+}
+
+void RenderQueue::Execute() {
+    RenderDevice &device = *RenderDevice::current;
+    programChanges = 0;
+    textureChanges = 0;
+    drawCalls = 0;
+    if (!commands.empty()) {
+        Sort();
+        GLuint streamBuffer = 0;
+        GLint streamFirst = 0;
+        if (!streamVertices.empty()) {
+            size_t offset;
+            streamBuffer = device.StreamVertices(streamVertices.data(), streamVertices.size() * sizeof(float), &offset);
+            streamFirst = (GLint)(offset / (4 * sizeof(float)));
+        }
+
+        ShaderProgram *program = nullptr;
+        bool textureKnown = false, bufferKnown = false;
+        GLuint texture = 0, buffer = 0;
+        VertexFormat format = VERTEX_FLOAT;
+        for (uint32_t index : order) {
+            RenderCommand &command = commands[index];
+            if (command.program != program) {
+                if (program != nullptr) {
+                    device.UnbindVertices(*program);
+                }
+                program = command.program;
+                device.UseProgram(*program);
+                programChanges++;
+                bufferKnown = false;
+            }
+            if (command.custom) {
+                command.custom();
+                drawCalls++;
+                // whatever it left bound is unknown now
+                textureKnown = bufferKnown = false;
+                continue;
+            }
+            if (!textureKnown || command.textureID != texture) {
+                device.BindTexture(command.textureID);
+                texture = command.textureID;
+                textureKnown = true;
+                textureChanges++;
+            }
+            device.SetModelMatrix(*program, command.modelMatrix);
+            GLuint source = command.vertexBuffer != 0 ? command.vertexBuffer : streamBuffer;
+            GLint first = command.vertexBuffer != 0 ? command.firstVertex : streamFirst + command.firstVertex;
+            if (!bufferKnown || source != buffer || command.format != format) {
+                device.BindVertices(*program, source, command.format);
+                buffer = source;
+                format = command.format;
+                bufferKnown = true;
+            }
+            if (command.format == VERTEX_PACKED) {
+                device.DrawQuads(first, command.vertexCount);
+            } else {
+                device.DrawTriangles(first, command.vertexCount);
+            }
+            drawCalls++;
+        }
+        device.UnbindVertices(*program);
+    }
+    commands.clear();
+    streamVertices.clear();
+    for (GLuint released : releasedBuffers) {
+        device.DeleteBuffer(released);
+    }
+    releasedBuffers.clear();
+}
+
+void RenderQueue::Cleanup() {
+    commands.clear();
+    streamVertices.clear();
+    for (GLuint released : releasedBuffers) {
+        RenderDevice::current->DeleteBuffer(released);
+    }
+    releasedBuffers.clear();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "ShaderProgram.h"
+#include "RenderDevice.h"
+#include "glm/mat4x4.hpp"
+
+// Sort key layout, most significant bits first: layer (8), program (8),
+// texture (16), depth (32). Layers give the painter's order; inside a layer
+// commands are grouped by program and then texture so state changes are
+// rare, and depth orders what is left. Commands with equal keys run in the
+// order they were submitted.
+uint64_t RenderSortKey(unsigned int layer, GLuint programID, GLuint textureID, float depth = 0.0f);
+
+// One draw of x, y, u, v triangles, or of packed quads.
+struct RenderCommand {
+    uint64_t key;
+    ShaderProgram *program;
+    GLuint textureID;
+    glm::mat4 modelMatrix;
+    // static buffer to draw from, or 0 to draw from the queue's vertex stream
+    GLuint vertexBuffer;
+    VertexFormat format;
+    // counted in quads for VERTEX_PACKED
+    GLint firstVertex;
+    GLsizei vertexCount;
+    // when set, runs instead of the draw above with program bound; it may
+    // change any GL state except the bound program
+    std::function<void()> custom;
+};
+
+// Draw commands submitted during a frame, sorted by key and run together.
+class RenderQueue {
+    public:
+        RenderQueue();
+
+        void Submit(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                    GLuint vertexBuffer, GLsizei vertexCount, GLint firstVertex = 0);
+        // draws quads of PackedVertex corners from a static buffer
+        void SubmitQuads(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                         GLuint vertexBuffer, GLsizei quadCount, GLint firstQuad = 0);
+        // copies the vertices into the queue's stream, which is written to
+        // the device's stream in one piece when the queue executes
+        void SubmitVertices(uint64_t key, ShaderProgram &program, GLuint textureID, const glm::mat4 &modelMatrix,
+                            const float *vertices, GLsizei vertexCount);
+        void SubmitCustom(uint64_t key, ShaderProgram &program, std::function<void()> draw);
+        // deletes a buffer once the commands already submitted have run
+        void ReleaseBuffer(GLuint buffer);
+
+        // sorts and runs everything submitted, then empties the queue
+        void Execute();
+        void Cleanup();
+
+        // program binds, texture binds and draw calls made by the last Execute
+        int programChanges;
+        int textureChanges;
+        int drawCalls;
+
+    private:
+        void Sort();
+
+        std::vector<RenderCommand> commands;
+        std::vector<uint32_t> order;        // command indices, sorted by key
+        std::vector<uint32_t> scratch;
+        std::vector<float> streamVertices;
+        std::vector<GLuint> releasedBuffers;
+};
@@ -1,6 +1,13 @@
 
 #include "ShaderProgram.h"
 
+GLuint ShaderProgram::boundProgram = 0;
+int ShaderProgram::skippedBinds = 0;
+int ShaderProgram::skippedUploads = 0;
+long ShaderProgram::totalSkippedBinds = 0;
+long ShaderProgram::totalSkippedUploads = 0;
+int ShaderProgram::countedFrames = 0;
+
 void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
     
     // create the vertex shader
@@ -8,10 +15,23 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
     // create the fragment shader
     fragmentShader = LoadShaderFromFile(fragmentShaderFile, GL_FRAGMENT_SHADER);
     
+    Link();
+}
+
+void ShaderProgram::LoadFromSource(const std::string &vertexShaderSource, const std::string &fragmentShaderSource) {
+    vertexShader = LoadShaderFromString(vertexShaderSource, GL_VERTEX_SHADER);
+    fragmentShader = LoadShaderFromString(fragmentShaderSource, GL_FRAGMENT_SHADER);
+    Link();
+}
+
+void ShaderProgram::Link() {
     // Create the final shader program from our vertex and fragment shaders
     programID = glCreateProgram();
     glAttachShader(programID, vertexShader);
     glAttachShader(programID, fragmentShader);
+    // keep position on attribute 0; legacy contexts only draw when attribute 0 is an enabled array,
+    // and the instanced sprite attributes must never land there
+    glBindAttribLocation(programID, 0, "position");
     glLinkProgram(programID);
     
     GLint linkSuccess;
@@ -27,12 +47,18 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
     
     positionAttribute = glGetAttribLocation(programID, "position");
     texCoordAttribute = glGetAttribLocation(programID, "texCoord");
+    
+    // a freshly linked program holds none of the values we have seen
+    modelMatrixSet = projectionMatrixSet = viewMatrixSet = colorSet = false;
 	
 	SetColor(1.0f, 1.0f, 1.0f, 1.0f);
     
 }
 
 void ShaderProgram::Cleanup() {
+    if(boundProgram == programID) {
+        boundProgram = 0;
+    }
     glDeleteProgram(programID);
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
@@ -83,22 +109,80 @@ GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GL
     return shaderID;
 }
 
+void ShaderProgram::Use() {
+    if(boundProgram == programID) {
+        skippedBinds++;
+        return;
+    }
+    glUseProgram(programID);
+    boundProgram = programID;
+}
+
+void ShaderProgram::ResetCounters() {
+    totalSkippedBinds += skippedBinds;
+    totalSkippedUploads += skippedUploads;
+    countedFrames++;
+    skippedBinds = 0;
+    skippedUploads = 0;
+}
+
+void ShaderProgram::PrintCounters() {
+    std::cout << "Shader state: " << countedFrames << " frames, " << totalSkippedBinds << " binds and "
+              << totalSkippedUploads << " uniform uploads skipped";
+    if (countedFrames > 0) {
+        std::cout << " (" << (double)totalSkippedBinds / countedFrames << " and "
+                  << (double)totalSkippedUploads / countedFrames << " per frame)";
+    }
+    std::cout << std::endl;
+}
+
 void ShaderProgram::SetColor(float r, float g, float b, float a) {
-	glUseProgram(programID);
+	if(colorSet && color[0] == r && color[1] == g && color[2] == b && color[3] == a) {
+		skippedBinds++;
+		skippedUploads++;
+		return;
+	}
+	color[0] = r;
+	color[1] = g;
+	color[2] = b;
+	color[3] = a;
+	colorSet = true;
+	Use();
 	glUniform4f(colorUniform, r, g, b, a);
 }
 
 void ShaderProgram::SetViewMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
+    if(viewMatrixSet && viewMatrix == matrix) {
+        skippedBinds++;
+        skippedUploads++;
+        return;
+    }
+    viewMatrix = matrix;
+    viewMatrixSet = true;
+    Use();
     glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::SetModelMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
+    if(modelMatrixSet && modelMatrix == matrix) {
+        skippedBinds++;
+        skippedUploads++;
+        return;
+    }
+    modelMatrix = matrix;
+    modelMatrixSet = true;
+    Use();
     glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::SetProjectionMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
-    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);    
+    if(projectionMatrixSet && projectionMatrix == matrix) {
+        skippedBinds++;
+        skippedUploads++;
+        return;
+    }
+    projectionMatrix = matrix;
+    projectionMatrixSet = true;
+    Use();
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
@@ -0,0 +1,362 @@
+#include "SoftwareRenderDevice.h"
+#include "PNGWriter.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "glm/vec4.hpp"
+
+namespace {
+
+// One side of a triangle as A * x + B * y + C, positive inside. The
+// coefficients of a shared edge are exact negations of each other, so the
+// top-left rule below gives every pixel on it to exactly one triangle.
+struct Edge {
+    double a, b, c;
+    bool inclusive;
+
+    void Set(double x0, double y0, double x1, double y1) {
+        a = y0 - y1;
+        b = x1 - x0;
+        c = x0 * y1 - x1 * y0;
+    }
+    void Flip() {
+        a = -a;
+        b = -b;
+        c = -c;
+    }
+    // narrows [*first, *last] to the pixels of row y whose centres are inside
+    void Clip(double y, int *first, int *last) const {
+        double k = b * y + c;
+        if (a == 0.0) {
+            if (k < 0.0 || (k == 0.0 && !inclusive)) {
+                *last = *first - 1;
+            }
+            return;
+        }
+        double t = -k / a - 0.5;
+        if (a > 0.0) {
+            *first = std::max(*first, inclusive ? (int)std::ceil(t) : (int)std::floor(t) + 1);
+        } else {
+            *last = std::min(*last, inclusive ? (int)std::floor(t) : (int)std::ceil(t) - 1);
+        }
+    }
+};
+
+// wraps like GL_REPEAT, only dividing for coordinates off the texture
+inline int Wrap(int i, int size) {
+    if ((unsigned)i < (unsigned)size) {
+        return i;
+    }
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+}
+
+SoftwareRenderDevice::SoftwareRenderDevice(int width, int height, int threads) : width(width), height(height),
+    threadCount(threads), pixels((size_t)width * height * 4, 0), rasterMilliseconds(0.0), nextBuffer(1), nextTexture(1),
+    streamBuffer(0), program(nullptr), boundBuffer(0), boundFormat(VERTEX_FLOAT), boundTexture(0) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+}
+
+void SoftwareRenderDevice::BeginFrame() {
+    triangles.clear();
+}
+
+void SoftwareRenderDevice::EndFrame() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // glClear with the default clear colour
+    std::fill(pixels.begin(), pixels.end(), 0);
+    int bands = (height + TILE_ROWS - 1) / TILE_ROWS;
+    std::atomic<int> nextBand(0);
+    auto work = [this, bands, &nextBand]() {
+        std::vector<uint8_t> span((size_t)width * 4);
+        int band;
+        while ((band = nextBand++) < bands) {
+            RasterizeRows(band * TILE_ROWS, std::min(height, (band + 1) * TILE_ROWS) - 1, span.data());
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < std::min(threadCount, bands); i++) {
+        workers.push_back(std::thread(work));
+    }
+    work();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    triangles.clear();
+    if (streamBuffer != 0) {
+        buffers[streamBuffer].clear();
+    }
+    rasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+GLuint SoftwareRenderDevice::CreateBuffer() {
+    buffers[nextBuffer];
+    return nextBuffer++;
+}
+
+void SoftwareRenderDevice::UploadBuffer(GLuint buffer, const void *data, size_t bytes, bool dynamic) {
+    const uint8_t *source = (const uint8_t*)data;
+    buffers[buffer].assign(source, source + bytes);
+}
+
+void SoftwareRenderDevice::DeleteBuffer(GLuint buffer) {
+    buffers.erase(buffer);
+}
+
+GLuint SoftwareRenderDevice::StreamVertices(const void *data, size_t bytes, size_t *offset) {
+    if (streamBuffer == 0) {
+        streamBuffer = nextBuffer++;
+    }
+    std::vector<uint8_t> &stream = buffers[streamBuffer];
+    *offset = (stream.size() + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+    stream.resize(*offset);
+    stream.insert(stream.end(), (const uint8_t*)data, (const uint8_t*)data + bytes);
+    return streamBuffer;
+}
+
+// only the full size level is kept; the games draw their textures at or above
+// their own size, where GL would not pick a smaller level either
+GLuint SoftwareRenderDevice::CreateTexture(const unsigned char *rgba, int textureWidth, int textureHeight, bool linear, int levels) {
+    Texture &texture = textures[nextTexture];
+    texture.width = textureWidth;
+    texture.height = textureHeight;
+    texture.linear = linear;
+    texture.texels.assign(rgba, rgba + (size_t)textureWidth * textureHeight * 4);
+    return nextTexture++;
+}
+
+void SoftwareRenderDevice::DeleteTexture(GLuint texture) {
+    textures.erase(texture);
+}
+
+void SoftwareRenderDevice::UseProgram(ShaderProgram &next) {
+    program = &next;
+}
+
+void SoftwareRenderDevice::SetModelMatrix(ShaderProgram &target, const glm::mat4 &matrix) {
+    matrices[&target].model = matrix;
+}
+
+void SoftwareRenderDevice::SetViewMatrix(ShaderProgram &target, const glm::mat4 &matrix) {
+    matrices[&target].view = matrix;
+}
+
+void SoftwareRenderDevice::SetProjectionMatrix(ShaderProgram &target, const glm::mat4 &matrix) {
+    matrices[&target].projection = matrix;
+}
+
+void SoftwareRenderDevice::BindTexture(GLuint textureID) {
+    boundTexture = textureID;
+}
+
+void SoftwareRenderDevice::BindVertices(ShaderProgram &target, GLuint buffer, VertexFormat format) {
+    boundBuffer = buffer;
+    boundFormat = format;
+}
+
+void SoftwareRenderDevice::UnbindVertices(ShaderProgram &target) {}
+
+void SoftwareRenderDevice::DrawTriangles(GLint firstVertex, GLsizei vertexCount) {
+    std::map<GLuint, std::vector<uint8_t> >::const_iterator buffer = buffers.find(boundBuffer);
+    glm::mat4 transform;
+    const Texture *texture;
+    if (buffer == buffers.end() || boundFormat != VERTEX_FLOAT || !DrawState(&transform, &texture)) {
+        return;
+    }
+    const float *vertices = (const float*)buffer->second.data();
+    size_t available = buffer->second.size() / (4 * sizeof(float));
+    for (GLsizei i = 0; i + 3 <= vertexCount; i += 3) {
+        if ((size_t)(firstVertex + i + 3) > available) {
+            break;
+        }
+        const float *corners[3];
+        for (int corner = 0; corner < 3; corner++) {
+            corners[corner] = &vertices[(firstVertex + i + corner) * 4];
+        }
+        QueueTriangle(transform, texture, corners);
+    }
+}
+
+void SoftwareRenderDevice::DrawQuads(GLint firstQuad, GLsizei quadCount) {
+    std::map<GLuint, std::vector<uint8_t> >::const_iterator buffer = buffers.find(boundBuffer);
+    glm::mat4 transform;
+    const Texture *texture;
+    if (buffer == buffers.end() || boundFormat != VERTEX_PACKED || !DrawState(&transform, &texture)) {
+        return;
+    }
+    const PackedVertex *vertices = (const PackedVertex*)buffer->second.data();
+    size_t available = buffer->second.size() / (4 * sizeof(PackedVertex));
+    // decoded the way GL hands them to vertex_textured.glsl: positions as they are, texture coordinates normalized
+    float decoded[4][4];
+    for (GLsizei quad = firstQuad; quad < firstQuad + quadCount && (size_t)quad < available; quad++) {
+        for (int corner = 0; corner < 4; corner++) {
+            const PackedVertex &vertex = vertices[quad * 4 + corner];
+            decoded[corner][0] = vertex.x;
+            decoded[corner][1] = vertex.y;
+            decoded[corner][2] = vertex.u * PACKED_TEXCOORD_SCALE;
+            decoded[corner][3] = vertex.v * PACKED_TEXCOORD_SCALE;
+        }
+        const float *first[3] = {decoded[0], decoded[1], decoded[2]};
+        const float *second[3] = {decoded[0], decoded[2], decoded[3]};
+        QueueTriangle(transform, texture, first);
+        QueueTriangle(transform, texture, second);
+    }
+}
+
+bool SoftwareRenderDevice::DrawState(glm::mat4 *transform, const Texture **texture) {
+    std::map<GLuint, Texture>::const_iterator found = textures.find(boundTexture);
+    if (program == nullptr || found == textures.end()) {
+        return false;
+    }
+    const Matrices &m = matrices[program];
+    *transform = m.projection * m.view * m.model;
+    *texture = &found->second;
+    return true;
+}
+
+void SoftwareRenderDevice::QueueTriangle(const glm::mat4 &transform, const Texture *texture, const float *corners[3]) {
+    Triangle triangle;
+    triangle.texture = texture;
+    float top = (float)height, bottom = 0.0f;
+    for (int corner = 0; corner < 3; corner++) {
+        const float *vertex = corners[corner];
+        glm::vec4 clip = transform * glm::vec4(vertex[0], vertex[1], 0.0f, 1.0f);
+        triangle.x[corner] = (clip.x / clip.w * 0.5f + 0.5f) * width;
+        triangle.y[corner] = (0.5f - clip.y / clip.w * 0.5f) * height;
+        triangle.u[corner] = vertex[2];
+        triangle.v[corner] = vertex[3];
+        top = std::min(top, triangle.y[corner]);
+        bottom = std::max(bottom, triangle.y[corner]);
+    }
+    triangle.firstRow = std::max(0, (int)std::ceil(top - 0.5f));
+    triangle.lastRow = std::min(height - 1, (int)std::floor(bottom - 0.5f));
+    if (triangle.firstRow <= triangle.lastRow) {
+        triangles.push_back(triangle);
+    }
+}
+
+void SoftwareRenderDevice::RasterizeRows(int firstRow, int lastRow, uint8_t *span) {
+    for (const Triangle &triangle : triangles) {
+        if (triangle.lastRow >= firstRow && triangle.firstRow <= lastRow) {
+            FillTriangle(triangle, std::max(firstRow, triangle.firstRow), std::min(lastRow, triangle.lastRow), span);
+        }
+    }
+}
+
+void SoftwareRenderDevice::FillTriangle(const Triangle &t, int firstRow, int lastRow, uint8_t *span) {
+    double area = ((double)t.x[1] - t.x[0]) * ((double)t.y[2] - t.y[0]) - ((double)t.x[2] - t.x[0]) * ((double)t.y[1] - t.y[0]);
+    if (area == 0.0) {
+        return;
+    }
+    Edge edges[3];
+    for (int i = 0; i < 3; i++) {
+        int next = (i + 1) % 3;
+        edges[i].Set(t.x[i], t.y[i], t.x[next], t.y[next]);
+        if (area < 0.0) {
+            edges[i].Flip();
+        }
+        edges[i].inclusive = edges[i].a > 0.0 || (edges[i].a == 0.0 && edges[i].b > 0.0);
+    }
+    // texture coordinates are affine in screen space under an orthographic projection
+    float dx1 = t.x[1] - t.x[0], dy1 = t.y[1] - t.y[0], dx2 = t.x[2] - t.x[0], dy2 = t.y[2] - t.y[0];
+    float inverseArea = 1.0f / (float)area;
+    float dudx = ((t.u[1] - t.u[0]) * dy2 - (t.u[2] - t.u[0]) * dy1) * inverseArea;
+    float dudy = ((t.u[2] - t.u[0]) * dx1 - (t.u[1] - t.u[0]) * dx2) * inverseArea;
+    float dvdx = ((t.v[1] - t.v[0]) * dy2 - (t.v[2] - t.v[0]) * dy1) * inverseArea;
+    float dvdy = ((t.v[2] - t.v[0]) * dx1 - (t.v[1] - t.v[0]) * dx2) * inverseArea;
+
+    const Texture &texture = *t.texture;
+    const uint8_t *texels = texture.texels.data();
+    for (int row = firstRow; row <= lastRow; row++) {
+        double y = row + 0.5;
+        int first = 0, last = width - 1;
+        for (const Edge &edge : edges) {
+            edge.Clip(y, &first, &last);
+        }
+        if (first > last) {
+            continue;
+        }
+        float u = t.u[0] + dudx * (first + 0.5f - t.x[0]) + dudy * ((float)y - t.y[0]);
+        float v = t.v[0] + dvdx * (first + 0.5f - t.x[0]) + dvdy * ((float)y - t.y[0]);
+        int count = last - first + 1;
+        // sample the whole span first, then blend it
+        uint8_t *out = span;
+        if (texture.linear) {
+            // texel positions in 24.8 fixed point, the low byte weighting the next texel
+            float scaleU = texture.width * 256.0f, scaleV = texture.height * 256.0f;
+            for (int i = 0; i < count; i++, u += dudx, v += dvdx, out += 4) {
+                int fu = (int)std::floor(u * scaleU - 128.0f), fv = (int)std::floor(v * scaleV - 128.0f);
+                int wx = fu & 0xFF, wy = fv & 0xFF;
+                int x0 = Wrap(fu >> 8, texture.width), x1 = Wrap((fu >> 8) + 1, texture.width);
+                int y0 = Wrap(fv >> 8, texture.height), y1 = Wrap((fv >> 8) + 1, texture.height);
+                const uint8_t *a = texels + ((size_t)y0 * texture.width + x0) * 4;
+                const uint8_t *b = texels + ((size_t)y0 * texture.width + x1) * 4;
+                const uint8_t *c = texels + ((size_t)y1 * texture.width + x0) * 4;
+                const uint8_t *d = texels + ((size_t)y1 * texture.width + x1) * 4;
+                for (int channel = 0; channel < 4; channel++) {
+                    int top = a[channel] * (256 - wx) + b[channel] * wx;
+                    int bottom = c[channel] * (256 - wx) + d[channel] * wx;
+                    out[channel] = (uint8_t)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+                }
+            }
+        } else {
+            for (int i = 0; i < count; i++, u += dudx, v += dvdx, out += 4) {
+                int x = Wrap((int)std::floor(u * texture.width), texture.width);
+                int y = Wrap((int)std::floor(v * texture.height), texture.height);
+                memcpy(out, texels + ((size_t)y * texture.width + x) * 4, 4);
+            }
+        }
+        uint8_t *destination = &pixels[((size_t)row * width + first) * 4];
+        for (int i = 0; i < count * 4; i += 4) {
+            unsigned int alpha = span[i + 3];
+            if (alpha == 255) {
+                memcpy(destination + i, span + i, 4);
+            } else if (alpha != 0) {
+                for (int channel = i; channel < i + 4; channel++) {
+                    // (x + (x >> 8)) >> 8 divides by 255, rounded, for the 16 bit x here
+                    unsigned int blended = span[channel] * alpha + destination[channel] * (255 - alpha) + 128;
+                    destination[channel] = (uint8_t)((blended + (blended >> 8)) >> 8);
+                }
+            }
+        }
+    }
+}
+
+bool SoftwareRenderDevice::WritePNG(const std::string &fileName) const {
+    return ::WritePNG(fileName, pixels, width, height);
+}
+
+int SoftwareRenderDevice::ComparePNG(const std::string &fileName, int tolerance) const {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (file == NULL) {
+        return errno == ENOENT ? IMAGE_MISSING : IMAGE_INVALID;
+    }
+    int fileWidth = 0, fileHeight = 0, components = 0;
+    unsigned char *rgba = stbi_load_from_file(file, &fileWidth, &fileHeight, &components, 4);
+    fclose(file);
+    if (rgba == NULL || fileWidth != width || fileHeight != height) {
+        stbi_image_free(rgba);
+        return IMAGE_INVALID;
+    }
+    int different = 0;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        for (int channel = 0; channel < 3; channel++) {
+            if (std::abs((int)rgba[i * 4 + channel] - (int)pixels[i * 4 + channel]) > tolerance) {
+                different++;
+                break;
+            }
+        }
+    }
+    stbi_image_free(rgba);
+    return different;
+}
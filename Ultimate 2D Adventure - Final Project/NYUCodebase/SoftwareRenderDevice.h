@@ -0,0 +1,95 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdint>
+
+// Draws on the CPU into an RGBA8 frame, for headless runs that compare
+// frames against golden images. It covers what the games use: textured
+// triangles under orthographic matrices, sampled nearest or bilinear with
+// repeat wrapping and blended with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA.
+// Triangles are queued by DrawTriangles and DrawQuads and rasterized in
+// EndFrame, with threads taking bands of TILE_ROWS rows so each pixel still
+// blends in submission order.
+class SoftwareRenderDevice : public RenderDevice {
+    public:
+        // threads of 0 uses one per hardware thread
+        SoftwareRenderDevice(int width, int height, int threads = 0);
+
+        void BeginFrame();
+        void EndFrame();
+        GLuint CreateBuffer();
+        void UploadBuffer(GLuint buffer, const void *data, size_t bytes, bool dynamic);
+        void DeleteBuffer(GLuint buffer);
+        GLuint StreamVertices(const void *data, size_t bytes, size_t *offset);
+        GLuint CreateTexture(const unsigned char *rgba, int width, int height, bool linear, int levels);
+        void DeleteTexture(GLuint texture);
+        void UseProgram(ShaderProgram &program);
+        void SetModelMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void SetViewMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void SetProjectionMatrix(ShaderProgram &program, const glm::mat4 &matrix);
+        void BindTexture(GLuint textureID);
+        void BindVertices(ShaderProgram &program, GLuint buffer, VertexFormat format);
+        void UnbindVertices(ShaderProgram &program);
+        void DrawTriangles(GLint firstVertex, GLsizei vertexCount);
+        void DrawQuads(GLint firstQuad, GLsizei quadCount);
+
+        // the last finished frame as an RGBA PNG
+        bool WritePNG(const std::string &fileName) const;
+        // Returns how many pixels differ from the PNG by more than tolerance
+        // in any color channel, IMAGE_MISSING when there is no such file, or
+        // IMAGE_INVALID when it can't be decoded or its size differs.
+        int ComparePNG(const std::string &fileName, int tolerance) const;
+
+        static const int IMAGE_MISSING = -1;
+        static const int IMAGE_INVALID = -2;
+        static const int TILE_ROWS = 16;
+
+        int width;
+        int height;
+        int threadCount;
+        std::vector<uint8_t> pixels;    // RGBA, top row first
+        double rasterMilliseconds;      // time the last EndFrame took
+
+    private:
+        struct Texture {
+            int width;
+            int height;
+            bool linear;
+            std::vector<uint8_t> texels;
+        };
+        struct Matrices {
+            Matrices() : model(1.0f), view(1.0f), projection(1.0f) {}
+            glm::mat4 model;
+            glm::mat4 view;
+            glm::mat4 projection;
+        };
+        // screen space, in pixels from the top left
+        struct Triangle {
+            float x[3], y[3], u[3], v[3];
+            const Texture *texture;
+            int firstRow, lastRow;
+        };
+
+        // the bound program's full transform and the bound texture; false when either is missing
+        bool DrawState(glm::mat4 *transform, const Texture **texture);
+        // queues the triangle of three x, y, u, v corners
+        void QueueTriangle(const glm::mat4 &transform, const Texture *texture, const float *corners[3]);
+        // span is scratch space for one row of RGBA samples
+        void RasterizeRows(int firstRow, int lastRow, uint8_t *span);
+        void FillTriangle(const Triangle &triangle, int firstRow, int lastRow, uint8_t *span);
+
+        GLuint nextBuffer;
+        GLuint nextTexture;
+        std::map<GLuint, std::vector<uint8_t> > buffers;
+        GLuint streamBuffer;        // emptied by EndFrame
+        std::map<GLuint, Texture> textures;
+        std::map<const ShaderProgram*, Matrices> matrices;
+        ShaderProgram *program;
+        GLuint boundBuffer;
+        VertexFormat boundFormat;
+        GLuint boundTexture;
+        std::vector<Triangle> triangles;
+};
@@ -0,0 +1,61 @@
+#include "SpriteBatch.h"
+
+SpriteBatch::SpriteBatch() : drawCalls(0), quadCount(0), usedBatches(0), lastBatch(0) {}
+
+void SpriteBatch::Draw(GLuint textureID, const glm::mat4 &modelMatrix, float u, float v, float width, float height,
+                       float halfWidth, float halfHeight) {
+    // consecutive sprites nearly always share a texture, so check the last batch first
+    if (lastBatch >= usedBatches || batches[lastBatch].textureID != textureID) {
+        lastBatch = 0;
+        while (lastBatch < usedBatches && batches[lastBatch].textureID != textureID) {
+            lastBatch++;
+        }
+        if (lastBatch == usedBatches) {
+            if (usedBatches == batches.size()) {
+                batches.push_back(Batch());
+            }
+            batches[usedBatches].textureID = textureID;
+            batches[usedBatches].vertices.clear();
+            usedBatches++;
+        }
+    }
+
+    // corners only need the x, y and translation columns of the matrix
+    const float *m = &modelMatrix[0][0];
+    float leftX = -halfWidth * m[0], leftY = -halfWidth * m[1];
+    float rightX = halfWidth * m[0], rightY = halfWidth * m[1];
+    float bottomX = -halfHeight * m[4] + m[12], bottomY = -halfHeight * m[5] + m[13];
+    float topX = halfHeight * m[4] + m[12], topY = halfHeight * m[5] + m[13];
+
+    std::vector<float> &vertices = batches[lastBatch].vertices;
+    vertices.insert(vertices.end(), {
+        leftX + bottomX, leftY + bottomY, u, v + height,
+        rightX + topX, rightY + topY, u + width, v,
+        leftX + topX, leftY + topY, u, v,
+        rightX + topX, rightY + topY, u + width, v,
+        leftX + bottomX, leftY + bottomY, u, v + height,
+        rightX + bottomX, rightY + bottomY, u + width, v + height
+    });
+}
+
+void SpriteBatch::Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer) {
+    drawCalls = 0;
+    quadCount = 0;
+    glm::mat4 identity = glm::mat4(1.0f);
+    for (size_t i = 0; i < usedBatches; i++) {
+        std::vector<float> &vertices = batches[i].vertices;
+        queue.SubmitVertices(RenderSortKey(layer, p.programID, batches[i].textureID), p, batches[i].textureID, identity,
+                             vertices.data(), (GLsizei)(vertices.size() / 4));
+        drawCalls++;
+        quadCount += (int)(vertices.size() / 24);
+        vertices.clear();
+    }
+    usedBatches = 0;
+    lastBatch = 0;
+}
+
+void SpriteBatch::Cleanup() {
+    batches.clear();
+    usedBatches = 0;
+    lastBatch = 0;
+}
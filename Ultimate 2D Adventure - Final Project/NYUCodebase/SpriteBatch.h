@@ -0,0 +1,45 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <vector>
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+#include "glm/mat4x4.hpp"
+
+// Collects textured quads and submits them to a render queue with one
+// command per texture. Quads are transformed on the CPU, so a whole batch
+// shares the identity model matrix and the queue copies its vertices into
+// the frame's vertex stream. Quads that share a texture keep their
+// submission order.
+class SpriteBatch {
+    public:
+        SpriteBatch();
+
+        // Queues the quad (-halfWidth, -halfHeight)..(halfWidth, halfHeight)
+        // placed by modelMatrix, showing the sheet cell at (u, v) of size
+        // (width, height) with v growing downwards, as SheetSprite always drew.
+        void Draw(GLuint textureID, const glm::mat4 &modelMatrix, float u, float v, float width, float height,
+                  float halfWidth = 0.5f, float halfHeight = 0.5f);
+
+        // hands every queued batch to a render queue at the given layer and empties them
+        void Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer);
+        void Cleanup();
+
+        // commands and quads handed over by the last Submit
+        int drawCalls;
+        int quadCount;
+
+    private:
+        struct Batch {
+            GLuint textureID;
+            std::vector<float> vertices;    // x, y, u, v per vertex, six vertices per quad
+        };
+        // Batches stay allocated across submits so steady frames don't
+        // reallocate; only the first used entries are live.
+        std::vector<Batch> batches;
+        size_t usedBatches;
+        size_t lastBatch;
+};
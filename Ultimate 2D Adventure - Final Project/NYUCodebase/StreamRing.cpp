@@ -0,0 +1,190 @@
+#include "StreamRing.h"
+#include <SDL.h>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+// not in the legacy headers macOS ships
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+
+// a frame of the level needs a few KB; the sprite benchmark grows it
+const size_t STREAM_REGION_BYTES = 256 * 1024;
+// how long each glClientWaitSync call blocks before checking again
+const uint64_t STREAM_WAIT_NANOSECONDS = 1000000;
+
+StreamRing::StreamRing() : persistent(false), regionBytes(STREAM_REGION_BYTES), frameBytes(0), peakFrameBytes(0),
+    totalBytes(0), frames(0), fenceWaits(0), waitMilliseconds(0.0), orphans(0), resizes(0), setUp(false), inFrame(false),
+    buffer(0), mapped(nullptr), region(0), head(0), regionEnd(0), writtenBytes(0), bufferStorage(nullptr),
+    mapBufferRange(nullptr), fenceSync(nullptr), clientWaitSync(nullptr), deleteSync(nullptr) {
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        fences[i] = nullptr;
+    }
+}
+
+void StreamRing::Setup() {
+    setUp = true;
+    persistent = false;
+    if (SDL_GL_ExtensionSupported("GL_ARB_buffer_storage") && SDL_GL_ExtensionSupported("GL_ARB_sync")) {
+        bufferStorage = (BufferStorageFunc)SDL_GL_GetProcAddress("glBufferStorage");
+        mapBufferRange = (MapBufferRangeFunc)SDL_GL_GetProcAddress("glMapBufferRange");
+        fenceSync = (FenceSyncFunc)SDL_GL_GetProcAddress("glFenceSync");
+        clientWaitSync = (ClientWaitSyncFunc)SDL_GL_GetProcAddress("glClientWaitSync");
+        deleteSync = (DeleteSyncFunc)SDL_GL_GetProcAddress("glDeleteSync");
+        persistent = bufferStorage != nullptr && mapBufferRange != nullptr && fenceSync != nullptr &&
+                     clientWaitSync != nullptr && deleteSync != nullptr;
+    }
+    Create();
+}
+
+void StreamRing::Create() {
+    glGenBuffers(1, &buffer);
+    mapped = nullptr;
+    if (persistent) {
+        GLsizeiptr bytes = (GLsizeiptr)(regionBytes * STREAM_FRAMES);
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        bufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+        mapped = (unsigned char*)mapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (mapped == nullptr) {
+            // its storage is immutable now, so orphaning needs a fresh buffer
+            glDeleteBuffers(1, &buffer);
+            persistent = false;
+            Create();
+        }
+    }
+    // an orphaning buffer gets its store from BeginRegion
+}
+
+void StreamRing::BeginRegion() {
+    inFrame = true;
+    writtenBytes = 0;
+    if (persistent) {
+        Fence fence = fences[region];
+        if (fence != nullptr) {
+            if (clientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+                fenceWaits++;
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                while (clientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_NANOSECONDS) == GL_TIMEOUT_EXPIRED) {}
+                waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+            deleteSync(fence);
+            fences[region] = nullptr;
+        }
+        head = region * regionBytes;
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, regionBytes, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        orphans++;
+        head = 0;
+    }
+    regionEnd = head + regionBytes;
+}
+
+GLuint StreamRing::Write(const void *data, size_t bytes, size_t *offset) {
+    if (!setUp) {
+        Setup();
+    }
+    if (!inFrame) {
+        BeginRegion();
+    }
+    size_t start = (head + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+    if (start + bytes > regionEnd) {
+        // this frame's earlier writes may not be drawn yet, so the old buffer lives until EndFrame
+        retired.push_back(buffer);
+        DeleteFences();
+        do {
+            regionBytes *= 2;
+        } while (regionBytes < bytes);
+        resizes++;
+        Create();
+        size_t written = writtenBytes;
+        BeginRegion();
+        writtenBytes = written;
+        start = head;
+    }
+    if (persistent) {
+        memcpy(mapped + start, data, bytes);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, start, bytes, data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    head = start + bytes;
+    writtenBytes += bytes;
+    *offset = start;
+    return buffer;
+}
+
+void StreamRing::EndFrame() {
+    if (inFrame) {
+        if (persistent) {
+            fences[region] = fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        region = (region + 1) % STREAM_FRAMES;
+        frameBytes = writtenBytes;
+        peakFrameBytes = std::max(peakFrameBytes, frameBytes);
+        totalBytes += frameBytes;
+        frames++;
+        inFrame = false;
+    }
+    for (GLuint old : retired) {
+        glDeleteBuffers(1, &old);
+    }
+    retired.clear();
+}
+
+void StreamRing::DeleteFences() {
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        if (fences[i] != nullptr) {
+            deleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+}
+
+void StreamRing::Cleanup() {
+    DeleteFences();
+    for (GLuint old : retired) {
+        glDeleteBuffers(1, &old);
+    }
+    retired.clear();
+    if (buffer != 0) {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    mapped = nullptr;
+    setUp = false;
+    inFrame = false;
+}
+
+void StreamRing::PrintStats() const {
+    std::cout << "Vertex stream: ";
+    if (persistent) {
+        std::cout << "persistent mapped, " << STREAM_FRAMES << " x " << regionBytes / 1024 << " KB regions, ";
+    } else {
+        std::cout << "orphaned, " << regionBytes / 1024 << " KB, ";
+    }
+    std::cout << frames << " frames, last " << frameBytes / 1024.0 << " KB, peak " << peakFrameBytes / 1024.0 << " KB, "
+              << totalBytes / 1024 << " KB in all; " << fenceWaits << " fence waits (" << waitMilliseconds << " ms), "
+              << orphans << " orphans, " << resizes << " resizes" << std::endl;
+}
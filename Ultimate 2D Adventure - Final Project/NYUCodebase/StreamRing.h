@@ -0,0 +1,85 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// offsets Write hands back are multiples of this, so they fall on whole
+// float vertices and instance records
+const size_t STREAM_ALIGNMENT = 64;
+// frames of vertices the ring holds before it writes over the oldest
+const int STREAM_FRAMES = 3;
+
+// One GL buffer that every frame's dynamic vertices are written into,
+// split into STREAM_FRAMES regions used in turn. Where the driver has
+// GL_ARB_buffer_storage and GL_ARB_sync the buffer stays mapped and each
+// frame's region is fenced when the frame ends; reusing a region only
+// waits on its fence if the GPU is still reading it, which should take
+// more than STREAM_FRAMES frames in flight. Without them (the legacy 2.1
+// context macOS gives us) the buffer is orphaned at the start of each
+// frame and written with glBufferSubData, leaving the driver to rename
+// the store instead of stalling. A frame that outgrows its region moves
+// to a buffer twice the size; the old one is deleted when the frame ends,
+// after the draws already issued from it.
+class StreamRing {
+    public:
+        StreamRing();
+
+        // Copies bytes of data into this frame's region and returns the
+        // buffer it landed in, with its byte offset in *offset. It stays
+        // valid until EndFrame. Sets the ring up on first use, so the GL
+        // context has to exist by then.
+        GLuint Write(const void *data, size_t bytes, size_t *offset);
+        // fences the frame's region and moves on to the next one
+        void EndFrame();
+        void Cleanup();
+        // how the ring streams and what it has cost, written to std::cout
+        void PrintStats() const;
+
+        bool persistent;            // mapped and fenced, rather than orphaned
+        size_t regionBytes;         // bytes one frame can write before the ring grows
+        size_t frameBytes;          // bytes written by the last finished frame
+        size_t peakFrameBytes;
+        size_t totalBytes;
+        int frames;                 // frames that wrote anything
+        int fenceWaits;             // region reuses that found the GPU still reading it
+        double waitMilliseconds;    // time spent in those waits
+        int orphans;
+        int resizes;
+
+    private:
+        typedef struct __GLsync *Fence;
+        typedef void (APIENTRY *BufferStorageFunc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+        typedef void *(APIENTRY *MapBufferRangeFunc)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+        typedef Fence (APIENTRY *FenceSyncFunc)(GLenum condition, GLbitfield flags);
+        typedef GLenum (APIENTRY *ClientWaitSyncFunc)(Fence sync, GLbitfield flags, uint64_t timeout);
+        typedef void (APIENTRY *DeleteSyncFunc)(Fence sync);
+
+        void Setup();
+        // makes a buffer of STREAM_FRAMES regions, or one region when orphaning
+        void Create();
+        // starts this frame's region, waiting on its fence or orphaning the buffer
+        void BeginRegion();
+        void DeleteFences();
+
+        bool setUp;
+        bool inFrame;
+        GLuint buffer;
+        unsigned char *mapped;
+        int region;
+        size_t head;                // next free byte of the frame's region
+        size_t regionEnd;
+        size_t writtenBytes;        // so far this frame
+        Fence fences[STREAM_FRAMES];
+        std::vector<GLuint> retired;
+
+        BufferStorageFunc bufferStorage;
+        MapBufferRangeFunc mapBufferRange;
+        FenceSyncFunc fenceSync;
+        ClientWaitSyncFunc clientWaitSync;
+        DeleteSyncFunc deleteSync;
+};
@@ -0,0 +1,135 @@
+#include "TextCache.h"
+#include "RenderDevice.h"
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include "glm/mat4x4.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+
+// top-left corner of every glyph cell in the font grid, worked out once
+struct GlyphAtlas {
+    float u[256];
+    float v[256];
+
+    GlyphAtlas() {
+        for (int i = 0; i < 256; i++) {
+            u[i] = (float)(i % FONT_GLYPHS_PER_ROW) / FONT_GLYPHS_PER_ROW;
+            v[i] = (float)(i / FONT_GLYPHS_PER_ROW) / FONT_GLYPHS_PER_ROW;
+        }
+    }
+};
+
+const GlyphAtlas GLYPHS;
+
+}
+
+size_t TextKeyHash::operator()(const TextKey &key) const {
+    size_t hash = std::hash<std::string>()(key.text);
+    hash = hash * 31 + std::hash<float>()(key.size);
+    hash = hash * 31 + std::hash<float>()(key.spacing);
+    return hash * 31 + key.fontTexture;
+}
+
+TextMesh::TextMesh() : buffer(0), quadCount(0), fontTexture(0), positionScale(1.0f) {}
+
+void TextMesh::Build(const TextKey &key) {
+    const AtlasRegion &font = key.font;
+    const float glyphWidth = font.width / FONT_GLYPHS_PER_ROW, glyphHeight = font.height / FONT_GLYPHS_PER_ROW;
+    const float half = 0.5f * key.size;
+    quadCount = (GLsizei)key.text.size();
+    fontTexture = key.fontTexture;
+    if (quadCount == 0) {
+        return;
+    }
+    // the farthest corner from the origin lands on the int16 limit
+    float extent = std::max(std::fabs(half), std::fabs((key.size + key.spacing) * (quadCount - 1)) + std::fabs(half));
+    positionScale = extent > 0.0f ? extent / 32767.0f : 1.0f;
+    std::vector<PackedVertex> vertexData;
+    vertexData.reserve(key.text.size() * 4);
+    for (size_t i = 0; i < key.text.size(); i++) {
+        unsigned char glyph = (unsigned char)key.text[i];
+        float u = font.u + GLYPHS.u[glyph] * font.width, v = font.v + GLYPHS.v[glyph] * font.height;
+        float center = (key.size + key.spacing) * i;
+        int16_t left = (int16_t)std::lround((center - half) / positionScale), right = (int16_t)std::lround((center + half) / positionScale);
+        int16_t top = (int16_t)std::lround(half / positionScale), bottom = (int16_t)std::lround(-half / positionScale);
+        uint16_t u0 = PackTexCoord(u), u1 = PackTexCoord(u + glyphWidth);
+        uint16_t v0 = PackTexCoord(v), v1 = PackTexCoord(v + glyphHeight);
+        // top left, bottom left, bottom right, top right
+        vertexData.insert(vertexData.end(), {
+            {left, top, u0, v0},
+            {left, bottom, u0, v1},
+            {right, bottom, u1, v1},
+            {right, top, u1, v0}
+        });
+    }
+    if (buffer == 0) {
+        buffer = RenderDevice::current->CreateBuffer();
+    }
+    RenderDevice::current->UploadBuffer(buffer, vertexData.data(), vertexData.size() * sizeof(PackedVertex), false);
+}
+
+void TextMesh::Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer, float x, float y) const {
+    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 1.0f));
+    modelMatrix = glm::scale(modelMatrix, glm::vec3(positionScale, positionScale, 1.0f));
+    queue.SubmitQuads(RenderSortKey(layer, p.programID, fontTexture), p, fontTexture, modelMatrix, buffer, quadCount);
+}
+
+void TextMesh::Release() {
+    if (buffer != 0) {
+        RenderDevice::current->DeleteBuffer(buffer);
+    }
+    buffer = 0;
+    quadCount = 0;
+}
+
+void TextLabel::Set(GLuint fontTexture, const AtlasRegion &font, const std::string &text, float size, float spacing) {
+    TextKey next = {text, size, spacing, fontTexture, font};
+    if (mesh.buffer != 0 && next == key) {
+        return;
+    }
+    key = next;
+    mesh.Build(key);
+}
+
+void TextLabel::Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer, float x, float y) const {
+    mesh.Submit(queue, p, layer, x, y);
+}
+
+void TextLabel::Release() {
+    mesh.Release();
+    key = TextKey();
+}
+
+TextCache::TextCache(size_t capacity) : capacity(capacity) {}
+
+void TextCache::Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer, GLuint fontTexture, const AtlasRegion &font,
+                       const std::string &text, float size, float spacing, float x, float y) {
+    TextKey key = {text, size, spacing, fontTexture, font};
+    auto found = index.find(key);
+    if (found != index.end()) {
+        // move to the front so the oldest entry stays at the back
+        entries.splice(entries.begin(), entries, found->second);
+    } else {
+        if (capacity > 0 && entries.size() >= capacity) {
+            queue.ReleaseBuffer(entries.back().mesh.buffer);
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+        entries.push_front(Entry());
+        entries.front().key = key;
+        entries.front().mesh.Build(key);
+        index[key] = entries.begin();
+    }
+    entries.front().mesh.Submit(queue, p, layer, x, y);
+}
+
+void TextCache::Clear() {
+    for (Entry &entry : entries) {
+        entry.mesh.Release();
+    }
+    entries.clear();
+    index.clear();
+}
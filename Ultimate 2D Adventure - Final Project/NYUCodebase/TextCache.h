@@ -0,0 +1,89 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+#include "TextureAtlas.h"
+
+// Fonts are 16x16 grids of glyphs indexed by character code, filling either
+// their whole texture or one region of an atlas.
+const int FONT_GLYPHS_PER_ROW = 16;
+
+// everything a built text mesh depends on
+struct TextKey {
+    std::string text;
+    float size;
+    float spacing;
+    GLuint fontTexture;
+    AtlasRegion font;       // where the glyph grid sits in fontTexture
+
+    bool operator==(const TextKey &other) const {
+        return text == other.text && size == other.size && spacing == other.spacing && fontTexture == other.fontTexture &&
+               font.u == other.font.u && font.v == other.font.v && font.width == other.font.width && font.height == other.font.height;
+    }
+};
+
+struct TextKeyHash {
+    size_t operator()(const TextKey &key) const;
+};
+
+// One string's quads in a static vertex buffer, laid out as DrawText always
+// did: the first glyph is centred on the origin and the rest follow to its
+// right, size + spacing apart. Corners are packed in units of positionScale,
+// sized so the widest string still fits in an int16.
+class TextMesh {
+    public:
+        TextMesh();
+        void Build(const TextKey &key);
+        // queues the text with its first glyph centred on (x, y)
+        void Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer, float x, float y) const;
+        // meshes are copied around by value, so the buffer is freed explicitly
+        void Release();
+
+        GLuint buffer;
+        GLsizei quadCount;
+        GLuint fontTexture;
+        float positionScale;
+};
+
+// Text whose contents change at run time, such as a score. Set rebuilds the
+// mesh only when the text or its style actually differs from the last call.
+class TextLabel {
+    public:
+        void Set(GLuint fontTexture, const AtlasRegion &font, const std::string &text, float size, float spacing);
+        void Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer, float x, float y) const;
+        void Release();
+
+        TextKey key;
+        TextMesh mesh;
+};
+
+// Built meshes for strings drawn again and again, such as menu text. Once
+// more than capacity strings are held the least recently drawn one is freed.
+class TextCache {
+    public:
+        TextCache(size_t capacity = 64);
+
+        // Evicted buffers are handed to the queue to delete, so text submitted
+        // earlier in the frame still draws.
+        void Submit(RenderQueue &queue, ShaderProgram &p, unsigned int layer, GLuint fontTexture, const AtlasRegion &font,
+                    const std::string &text, float size, float spacing, float x, float y);
+        void Clear();
+
+        size_t capacity;
+
+    private:
+        struct Entry {
+            TextKey key;
+            TextMesh mesh;
+        };
+        // most recently drawn first
+        std::list<Entry> entries;
+        std::unordered_map<TextKey, std::list<Entry>::iterator, TextKeyHash> index;
+};
@@ -0,0 +1,67 @@
+#include "TextureAtlas.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cassert>
+#include <cmath>
+
+TextureAtlas::TextureAtlas() : textureID(0), width(0), height(0) {}
+
+bool TextureAtlas::Load(const std::string &tableFile) {
+    std::ifstream infile(tableFile);
+    if (!infile) {
+        std::cout << "Unable to read atlas table " << tableFile << std::endl;
+        return false;
+    }
+    regions.clear();
+    width = height = 0;
+    std::string line;
+    while (std::getline(infile, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream lineStream(line);
+        std::string name;
+        lineStream >> name;
+        if (name == "size") {
+            lineStream >> width >> height;
+            continue;
+        }
+        int x, y, regionWidth, regionHeight;
+        if (width <= 0 || height <= 0 || !(lineStream >> x >> y >> regionWidth >> regionHeight)) {
+            std::cout << "Bad line in atlas table " << tableFile << ": " << line << std::endl;
+            return false;
+        }
+        AtlasRegion region;
+        region.u = (float)x / width;
+        region.v = (float)y / height;
+        region.width = (float)regionWidth / width;
+        region.height = (float)regionHeight / height;
+        region.pixelWidth = regionWidth;
+        region.pixelHeight = regionHeight;
+        regions[name] = region;
+    }
+    return !regions.empty();
+}
+
+const AtlasRegion &TextureAtlas::Region(const std::string &name) const {
+    std::map<std::string, AtlasRegion>::const_iterator found = regions.find(name);
+    if (found == regions.end()) {
+        std::cout << "No region " << name << " in the atlas" << std::endl;
+        assert(false);
+        static const AtlasRegion missing = {0.0f, 0.0f, 0.0f, 0.0f, 0, 0};
+        return missing;
+    }
+    return found->second;
+}
+
+AtlasRegion TextureAtlas::SubRegion(const AtlasRegion &region, float u, float v, float width, float height) {
+    AtlasRegion sub;
+    sub.u = region.u + u * region.width;
+    sub.v = region.v + v * region.height;
+    sub.width = width * region.width;
+    sub.height = height * region.height;
+    sub.pixelWidth = (int)std::round(width * region.pixelWidth);
+    sub.pixelHeight = (int)std::round(height * region.pixelHeight);
+    return sub;
+}
@@ -0,0 +1,183 @@
+#include "TextureCache.h"
+#include "RenderDevice.h"
+#include "CookedTexture.h"
+#include "stb_image.h"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+
+namespace {
+
+// false when a cooked texture's header doesn't match the PNG at sourceName;
+// a missing PNG matches anything, since the .tex can ship without it
+bool Source_Matches(const CookedTextureHeader &header, const std::string &sourceName) {
+    MappedFile source;
+    if (!source.Open(sourceName)) {
+        return true;
+    }
+    return header.sourceSize == (uint32_t)source.size &&
+        header.sourceHash == CookedSourceHash(source.data, source.size);
+}
+
+// the .tex a PNG is cooked into, or an empty string for any other file
+std::string Cooked_Name(const std::string &path) {
+    const std::string png = ".png";
+    if (path.size() < png.size() || path.compare(path.size() - png.size(), png.size(), png) != 0) {
+        return std::string();
+    }
+    return path.substr(0, path.size() - png.size()) + ".tex";
+}
+
+double Milliseconds_Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+TextureFile::TextureFile() : texels(nullptr), width(0), height(0), levels(0), cooked(false), readMilliseconds(0.0), decoded(nullptr) {}
+
+TextureFile::~TextureFile() {
+    if (decoded != nullptr) {
+        stbi_image_free(decoded);
+    }
+}
+
+TextureCache::TextureCache() : hits(0), misses(0), cookedLoads(0), residentBytes(0), loadMilliseconds(0.0) {}
+
+GLuint TextureCache::Acquire(const std::string &path) {
+    std::map<std::string, Entry>::iterator found = entries.find(path);
+    if (found != entries.end()) {
+        found->second.references++;
+        hits++;
+        return found->second.textureID;
+    }
+    TextureFile file;
+    Read(path, file);
+    return Acquire(path, file);
+}
+
+GLuint TextureCache::Acquire(const std::string &path, TextureFile &file) {
+    std::map<std::string, Entry>::iterator found = entries.find(path);
+    if (found != entries.end()) {
+        found->second.references++;
+        hits++;
+        return found->second.textureID;
+    }
+    misses++;
+    if (file.texels == nullptr) {
+        std::cout << "Unable to load image " << path << ". Make sure the path is correct\n";
+        assert(false);
+        return 0;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    GLuint texture = RenderDevice::current->CreateTexture(file.texels, file.width, file.height, true, file.levels);
+    loadMilliseconds += file.readMilliseconds + Milliseconds_Since(start);
+    if (file.cooked) {
+        cookedLoads++;
+    }
+
+    Entry entry;
+    entry.textureID = texture;
+    entry.references = 1;
+    entry.bytes = CookedTexelBytes(file.width, file.height, file.levels);
+    entries[path] = entry;
+    paths[texture] = path;
+    residentBytes += entry.bytes;
+    return texture;
+}
+
+bool TextureCache::Read(const std::string &path, TextureFile &file) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string cooked = Cooked_Name(path);
+    bool read = (!cooked.empty() && ReadCooked(cooked, path, file)) || ReadPNG(path, file);
+    file.readMilliseconds = Milliseconds_Since(start);
+    return read;
+}
+
+void TextureCache::Release(GLuint textureID) {
+    std::map<GLuint, std::string>::iterator path = paths.find(textureID);
+    if (path == paths.end()) {
+        return;
+    }
+    Entry &entry = entries[path->second];
+    assert(entry.references > 0);
+    if (entry.references > 0) {
+        entry.references--;
+    }
+}
+
+int TextureCache::Purge() {
+    int purged = 0;
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end();) {
+        if (it->second.references == 0) {
+            Delete(it->second);
+            it = entries.erase(it);
+            purged++;
+        } else {
+            ++it;
+        }
+    }
+    return purged;
+}
+
+void TextureCache::Clear() {
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        Delete(it->second);
+    }
+    entries.clear();
+}
+
+void TextureCache::PrintStats() const {
+    std::cout << "Textures: " << entries.size() << " resident (" << residentBytes / 1024 << " KB), "
+              << hits << " hits, " << misses << " misses (" << cookedLoads << " cooked), "
+              << loadMilliseconds << " ms loading" << std::endl;
+}
+
+bool TextureCache::ReadPNG(const std::string &fileName, TextureFile &file) {
+    int comp;
+    file.decoded = stbi_load(fileName.c_str(), &file.width, &file.height, &comp, STBI_rgb_alpha);
+    if (file.decoded == NULL) {
+        return false;
+    }
+    file.texels = file.decoded;
+    file.levels = 1;
+    file.cooked = false;
+    return true;
+}
+
+bool TextureCache::ReadCooked(const std::string &fileName, const std::string &sourceName, TextureFile &file) {
+    if (!file.mapping.Open(fileName) || file.mapping.size < sizeof(CookedTextureHeader)) {
+        file.mapping.Close();
+        return false;
+    }
+    const CookedTextureHeader *header = (const CookedTextureHeader*)file.mapping.data;
+    bool valid = memcmp(header->magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC)) == 0 &&
+        header->version == COOKED_TEXTURE_VERSION &&
+        header->fileSize == file.mapping.size &&
+        header->width > 0 && header->height > 0 &&
+        header->levels > 0 && header->levels <= 32 &&
+        header->dataOffset + CookedTexelBytes(header->width, header->height, header->levels) <= file.mapping.size &&
+        Source_Matches(*header, sourceName);
+    if (!valid) {
+        file.mapping.Close();
+        return false;   // stale or foreign file, the caller falls back to the PNG
+    }
+    file.texels = file.mapping.data + header->dataOffset;
+    file.width = header->width;
+    file.height = header->height;
+    file.levels = header->levels;
+    file.cooked = true;
+    // fault the pages in now, so an upload on another thread doesn't wait on the disk
+    volatile unsigned char touched = 0;
+    for (size_t i = header->dataOffset; i < file.mapping.size; i += 4096) {
+        touched += file.mapping.data[i];
+    }
+    return true;
+}
+
+void TextureCache::Delete(const Entry &entry) {
+    RenderDevice::current->DeleteTexture(entry.textureID);
+    paths.erase(entry.textureID);
+    residentBytes -= entry.bytes;
+}
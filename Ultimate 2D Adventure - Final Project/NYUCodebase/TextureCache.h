@@ -0,0 +1,80 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <string>
+#include <map>
+#include <cstddef>
+#include "MappedFile.h"
+
+// An image read from disk and ready to upload: mapped from a cooked .tex
+// or decoded from a PNG. TextureCache::Read fills one on any thread; only
+// the upload in Acquire has to wait for the GL thread.
+class TextureFile {
+    public:
+        TextureFile();
+        ~TextureFile();
+
+        const unsigned char *texels;    // null until read
+        int width;
+        int height;
+        int levels;
+        bool cooked;
+        double readMilliseconds;
+
+        MappedFile mapping;         // holds a cooked file's texels
+        unsigned char *decoded;     // holds a PNG's, freed by the destructor
+
+    private:
+        TextureFile(const TextureFile &) = delete;
+        TextureFile &operator=(const TextureFile &) = delete;
+};
+
+// Textures keyed by the path they were loaded from. Acquiring a path that
+// is already loaded returns the same texture instead of decoding the image
+// again. Every Acquire takes a reference that Release hands back, and
+// Purge deletes the textures nobody holds any more. A PNG with an up to
+// date cooked .tex next to it (see CookedTexture.h) is loaded from that
+// instead, skipping the decode.
+class TextureCache {
+    public:
+        TextureCache();
+
+        // asserts when the image can't be loaded
+        GLuint Acquire(const std::string &path);
+        // the same, uploading file, which Read has already filled from path, on a miss
+        GLuint Acquire(const std::string &path, TextureFile &file);
+        // Reads path into file, preferring its cooked .tex, and returns false
+        // when neither can be read. It touches no cache state, so it may run
+        // on any thread while the cache is in use.
+        static bool Read(const std::string &path, TextureFile &file);
+        void Release(GLuint textureID);
+        // deletes every texture with no references left and returns how many
+        int Purge();
+        // deletes every texture, held or not
+        void Clear();
+        // hits, misses and resident textures, written to std::cout
+        void PrintStats() const;
+
+        int hits;
+        int misses;
+        int cookedLoads;            // misses served from a .tex
+        size_t residentBytes;       // RGBA8 bytes of every loaded texture, mip levels included
+        double loadMilliseconds;    // time spent reading and uploading on misses
+
+    private:
+        struct Entry {
+            GLuint textureID;
+            int references;
+            size_t bytes;
+        };
+        static bool ReadPNG(const std::string &fileName, TextureFile &file);
+        // a cooked file is only used while it matches the PNG at sourceName
+        static bool ReadCooked(const std::string &fileName, const std::string &sourceName, TextureFile &file);
+        void Delete(const Entry &entry);
+
+        std::map<std::string, Entry> entries;
+        std::map<GLuint, std::string> paths;
+};
@@ -7,7 +7,13 @@
 #include <vector>
 #include <string>
 #include <map>
-#include <set>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
 #ifdef _WINDOWS
 #define RESOURCE_FOLDER ""
 #else
@@ -18,7 +24,17 @@
 #include "glm/gtc/matrix_transform.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"      //load an image using STB_image
+#include "SpriteBatch.h"
+#include "InstancedSpriteBatch.h"
+#include "TextCache.h"
+#include "TextureAtlas.h"
+#include "TextureCache.h"
+#include "AssetLoader.h"
+#include "RenderQueue.h"
+#include "RenderDevice.h"
+#include "SoftwareRenderDevice.h"
 #include "FlareMap.h"
+#include "ChunkedMap.h"
 #include <SDL_mixer.h>
 
 //************************************
@@ -27,41 +43,80 @@
 SDL_Window* displayWindow;
 ShaderProgram textured_program;
 ShaderProgram untextured_program;
+SpriteBatch sprite_batch;   //entities are queued here and drawn a texture at a time
+InstancedSpriteBatch instanced_batch;   //used instead of sprite_batch when INSTANCED_SPRITES is set
+bool INSTANCED_SPRITES = false;     //set by Setup when the GPU supports instanced drawing
+RenderQueue render_queue;   //everything drawn in a frame is submitted here and runs sorted at the end of Render
+//render queue layers, drawn back to front
+enum RenderLayer {RENDER_BACKGROUND, RENDER_ENTITIES, RENDER_FOREGROUND, RENDER_UI};
+TextCache text_cache;       //built meshes of the strings DrawText has drawn recently
+TextLabel loading_label;    //the loading screen's animated text, rebuilt only when its dots change
 const float SCREEN_WIDTH = 1280.0, SCREEN_HEIGHT = 720.0;
 const int SPRITE_COUNT_X = 30, SPRITE_COUNT_Y = 30;
 const int MAX_TIMESTEPS = 60;
 const float TILE_SIZE = 0.13f;
+const int TILEMAP_CHUNK_SIZE = 16;  //map cells per side of each separately culled tile buffer
+//half the width and height of the world area the orthographic projection shows
+const float VIEW_HALF_HEIGHT = 1.0f, VIEW_HALF_WIDTH = VIEW_HALF_HEIGHT * SCREEN_WIDTH / SCREEN_HEIGHT;
 const float DISPLACEMENT = 0.0f;
 const float FIXED_TIMESTEP = 1.0/MAX_TIMESTEPS;
 glm::vec3 gravity = glm::vec3(0.0f, -1.2f, 0.0f), friction = glm::vec3(1.0f, 0.0f, 0.0f);
-GLuint SPRITE_SHEET, FONTS;
+TextureCache texture_cache;     //every texture the game has loaded, one per image path
+TextureAtlas ATLAS;     //the region table of atlas.png, which holds the sprite sheet and the font
+GLuint SPRITE_SHEET, FONTS;     //both name atlas.png
+//where the SPRITE_COUNT_X by SPRITE_COUNT_Y sprite grid and the 16x16 glyph grid sit in the atlas
+AtlasRegion SPRITE_REGION, FONT_REGION;
 Mix_Chunk *jumpSound, *coinSound, *deathSound;
 Mix_Music *music;
-//hold the indices of lethal tiles, such as water, lava, etc.
-std::set<int> LETHAL_TILE_INDEX = {577, 578, 579, 580, 42};
-//hold the entity names and their corresponding tile index.
-std::map<std::string, int> ENTITY_INDEX = {
-    {"player", 79}, {"red", 378}, {"green", 377}, {"blue", 379}, {"yellow", 376}, {"snowman", 139}, {"bee", 354}, {"spider", 472}, {"door", 732}, {"ghost", 446}, {"bird", 442}
-};
-//hold the entity names that are enemies
-std::set<std::string> ENEMIES = {"snowman", "bee", "spider", "bird", "ghost"};
+//hold every music track loaded so far, so replaying one doesn't reopen its file
+std::map<std::string, Mix_Music*> MUSIC_CACHE;
+//hold the file bytes of tracks opened from memory, which SDL_mixer keeps streaming from while they play
+std::map<std::string, std::string> MUSIC_FILES;
+//the title and menu track, preloaded by Setup; the name must match the bundled file, case included
+const std::string TITLE_MUSIC = "Title_Screen.mp3";
+//hold the track to fade in once the current one has faded out
+std::string pendingMusic;
+bool TRACE_STARTUP = false;     //set by --trace-startup, prints how long each of Setup's loading steps took
+//tile property bits, looked up per tile index in TILE_FLAGS
+enum TileFlag {TILE_SOLID = 1, TILE_LETHAL = 2, TILE_ONE_WAY = 4, TILE_LADDER = 8, TILE_TRIGGER = 16};
+//hold the properties of every possible tile index, read from Tileset.txt; sized so any FlareTile indexes it directly
+Uint8 TILE_FLAGS[1 << 16];
 
 //************************************
 //Global variables end here
 //************************************
 
+//loads a music track the first time it is asked for, or returns nullptr when it can't be opened
+Mix_Music* Load_Music(const std::string& title) {
+    std::map<std::string, Mix_Music*>::iterator found = MUSIC_CACHE.find(title);
+    if (found != MUSIC_CACHE.end()) {
+        return found->second;
+    }
+    Mix_Music* track = Mix_LoadMUS((std::string(RESOURCE_FOLDER) + title).c_str());
+    if (track != nullptr) {     //a track that failed to open is tried again next time
+        MUSIC_CACHE[title] = track;
+    }
+    return track;
+}
+
 //plays music with fadein/outs
 void Play_Music(const std::string& title) {
     if (!Mix_PlayingMusic()) {  //if not already playing music, play music.
-        music = Mix_LoadMUS((std::string(RESOURCE_FOLDER) + title).c_str());
+        music = Load_Music(title);
         Mix_FadeInMusic(music, 2, 2000);
-    } else {        //if playing music, fade out and then play music.
-        while(!Mix_FadeOutMusic(2000) && Mix_PlayingMusic()) {
-            // wait for any fades to complete
-            SDL_Delay(100);
-        }
-        music = Mix_LoadMUS((std::string(RESOURCE_FOLDER) + title).c_str());
+        pendingMusic.clear();
+    } else {        //if playing music, fade out and let Update_Music play the new track once the fade is done
+        Mix_FadeOutMusic(2000);
+        pendingMusic = title;
+    }
+}
+
+//starts the queued track once the previous one has faded out, so fades never stall the frame loop
+void Update_Music() {
+    if (!pendingMusic.empty() && !Mix_PlayingMusic()) {
+        music = Load_Music(pendingMusic);
         Mix_FadeInMusic(music, 2, 2000);
+        pendingMusic.clear();
     }
 }
 
@@ -74,36 +129,118 @@ public:
     SheetSprite() {}
     SheetSprite(unsigned int textureID, int index) {
         this->textureID = textureID;
-        this->u = (float)(((int)index) % SPRITE_COUNT_X) / (float) SPRITE_COUNT_X;
-        this->v = (float)(((int)index) / SPRITE_COUNT_X) / (float) SPRITE_COUNT_Y;
-        this->width = 1.0/(float)SPRITE_COUNT_X;
-        this->height = 1.0/(float)SPRITE_COUNT_Y;
-    }
-    void Draw(ShaderProgram&p) {
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        GLfloat texCoords[] = {
-            u, v+height,
-            u+width, v,
-            u, v,
-            u+width, v,
-            u, v+height,
-            u+width, v+height
-        };
-        GLfloat vertices[] = {-0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, -0.5f, -0.5f, 0.5f, -0.5f};
-        glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-        glEnableVertexAttribArray(p.positionAttribute);
-        glEnableVertexAttribArray(p.texCoordAttribute);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDisableVertexAttribArray(p.positionAttribute);
-        glDisableVertexAttribArray(p.texCoordAttribute);
+        this->width = SPRITE_REGION.width / (float)SPRITE_COUNT_X;
+        this->height = SPRITE_REGION.height / (float)SPRITE_COUNT_Y;
+        this->u = SPRITE_REGION.u + (float)(((int)index) % SPRITE_COUNT_X) * width;
+        this->v = SPRITE_REGION.v + (float)(((int)index) / SPRITE_COUNT_X) * height;
+    }
+    void Draw(SpriteBatch& batch, const glm::mat4& modelMatrix) {
+        batch.Draw(textureID, modelMatrix, u, v, width, height);
+    }
+    void Draw(InstancedSpriteBatch& batch, const glm::vec3& position, const glm::vec3& size) {
+        batch.Draw(textureID, position.x, position.y, size.x, size.y, u, v, width, height);
     }
     float u, v, width, height;
     unsigned int textureID;
 };
 
+//tile geometry kept in a static buffer of packed quads. Tiles are appended on the CPU (safe on the
+//loading thread), uploaded once on the main thread and then drawn with a single call per frame.
+//Corners are stored in whole tiles from the first appended tile, and the model matrix scales them back.
+class TileMesh {
+public:
+    //tiles is a width x height block with rows stride tiles apart, whose first cell sits at map cell (originX, originY)
+    void Append(const FlareTile* tiles, int width, int height, int stride, int originX, int originY) {
+        float spriteWidth = SPRITE_REGION.width / (float)SPRITE_COUNT_X;
+        float spriteHeight = SPRITE_REGION.height / (float)SPRITE_COUNT_Y;
+        if (vertexData.empty()) {
+            meshX = originX;
+            meshY = originY;
+        }
+        for(int x = 0; x < width; x++) {
+            for(int y = 0; y < height; y++) {
+                int tile = tiles[y * stride + x];
+                if(tile != 0) {
+                    float u = SPRITE_REGION.u + (float)(tile % SPRITE_COUNT_X) * spriteWidth;
+                    float v = SPRITE_REGION.v + (float)(tile / SPRITE_COUNT_X) * spriteHeight;
+                    int16_t left = (int16_t)(originX + x - meshX), top = (int16_t)(meshY - originY - y);
+                    uint16_t u0 = PackTexCoord(u), u1 = PackTexCoord(u + spriteWidth);
+                    uint16_t v0 = PackTexCoord(v), v1 = PackTexCoord(v + spriteHeight);
+                    //top left, bottom left, bottom right, top right
+                    vertexData.insert(vertexData.end(), {
+                        {left, top, u0, v0},
+                        {left, (int16_t)(top-1), u0, v1},
+                        {(int16_t)(left+1), (int16_t)(top-1), u1, v1},
+                        {(int16_t)(left+1), top, u1, v0}
+                    });
+                }
+            }
+        }
+    }
+    //copy the appended quads into the buffer and drop the CPU copy
+    void Upload() {
+        quadCount = vertexData.size()/4;
+        if (quadCount > 0) {
+            if (buffer == 0) {
+                buffer = RenderDevice::current->CreateBuffer();
+            }
+            RenderDevice::current->UploadBuffer(buffer, vertexData.data(), vertexData.size() * sizeof(PackedVertex), false);
+        }
+        std::vector<PackedVertex>().swap(vertexData);
+    }
+    void Submit(RenderQueue& queue, ShaderProgram& p, int textureID, unsigned int layer) {
+        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(TILE_SIZE * meshX, -TILE_SIZE * meshY, 0.0f));
+        modelMatrix = glm::scale(modelMatrix, glm::vec3(TILE_SIZE, TILE_SIZE, 1.0f));
+        queue.SubmitQuads(RenderSortKey(layer, p.programID, textureID), p, textureID, modelMatrix, buffer, quadCount);
+    }
+    //meshes are copied around by value, so the buffer is freed explicitly
+    void Release() {
+        if (buffer != 0) {
+            RenderDevice::current->DeleteBuffer(buffer);
+        }
+        buffer = 0;
+        quadCount = 0;
+        std::vector<PackedVertex>().swap(vertexData);
+    }
+    GLuint buffer = 0;
+    GLsizei quadCount = 0;
+    int meshX = 0, meshY = 0;       //map cell the stored corners are measured from
+    std::vector<PackedVertex> vertexData;
+};
+
+//foreground layers are drawn in front of the entities, all other layers behind them
+class TilemapMeshes {
+public:
+    //append every layer of a block of tiles; layer i's tiles start at layerTiles[i]
+    void Append(const std::vector<FlareMapLayer>& layers, const std::vector<const FlareTile*>& layerTiles, int width, int height, int stride, int originX, int originY) {
+        for (size_t i = 0; i < layers.size(); i++) {
+            TileMesh& mesh = (layers[i].role == LAYER_FOREGROUND) ? foreground : background;
+            mesh.Append(layerTiles[i], width, height, stride, originX, originY);
+        }
+    }
+    void Upload() {
+        background.Upload();
+        foreground.Upload();
+    }
+    void Release() {
+        background.Release();
+        foreground.Release();
+    }
+    TileMesh background;
+    TileMesh foreground;
+};
+
 enum EntityType {ENTITY_PLAYER, ENTITY_ENEMY, ENTITY_COIN, ENTITY_DOOR};
 
+//what a Flare object type spawns as, read from Archetypes.txt
+struct EntityArchetype {
+    int tile = 0;
+    EntityType kind = ENTITY_COIN;
+    glm::vec3 acceleration = glm::vec3(0.0f, 0.0f, 0.0f);
+};
+//hold the archetypes indexed by FlareMap entity type id
+std::vector<EntityArchetype> ARCHETYPES;
+
 class Entity {
 public:
     bool collidesWith(Entity& entity) {     //Box-Box collision detection.
@@ -114,12 +251,16 @@ public:
         }
         return false;
     }
-    void Draw(ShaderProgram &p) {
+    //queue the sprite on whichever sprite path Setup picked; Submit_Sprites hands it to the render queue
+    void Draw() {
+        if (INSTANCED_SPRITES) {
+            sprite.Draw(instanced_batch, position, size);
+            return;
+        }
         glm::mat4 newMatrix = glm::mat4(1.0f);
         newMatrix = glm::translate(newMatrix, position);
         newMatrix = glm::scale(newMatrix, size);
-        p.SetModelMatrix(newMatrix);
-        sprite.Draw(p);
+        sprite.Draw(sprite_batch, newMatrix);
     }
     glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), size = glm::vec3(0.0f, 0.0f, 0.0f),
         velocity = glm::vec3(0.0f, 0.0f, 0.0f), acceleration = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -128,17 +269,51 @@ public:
     SheetSprite sprite;
 };
 
+//a level as it was loaded: its map, meshes and freshly spawned entities.
+//The map and meshes never change during play, so they are shared with GameState;
+//the entity lists are the pristine copies a restart starts from.
+class Level {
+public:
+    std::string name;   //Level_N, which names its map files
+    std::string music;
+    FlareMap map = FlareMap();
+    //whole-map levels cut their tile buffers into TILEMAP_CHUNK_SIZE squares, row-major, so drawing can skip the ones off screen
+    std::vector<TilemapMeshes> chunks = std::vector<TilemapMeshes>();
+    int chunkCountX = 0, chunkCountY = 0;
+    //streamed levels keep only the chunks near the camera, with one mesh per layer for each
+    ChunkedMap world;
+    std::map<int, TilemapMeshes> chunkMeshes = std::map<int, TilemapMeshes>();
+    std::vector<Entity> player = std::vector<Entity>();
+    std::vector<Entity> enemies = std::vector<Entity>();
+    std::vector<Entity> coins = std::vector<Entity>();
+    std::vector<Entity> doors = std::vector<Entity>();
+};
+
 class GameState {
 public:
     std::vector<Entity> player = std::vector<Entity>();
     std::vector<Entity> enemies = std::vector<Entity>();
     std::vector<Entity> coins = std::vector<Entity>();
     std::vector<Entity> doors = std::vector<Entity>();
-    FlareMap map = FlareMap();
+    Level* level = nullptr;     //the level being played, owned by LEVEL_CACHE
+    //the world rectangle the view matrix currently shows
+    float cameraLeft = 0.0f, cameraRight = 0.0f, cameraTop = 0.0f, cameraBottom = 0.0f;
 };
 
-enum GameMode {TITLE_SCREEN, GAME_LEVEL1, GAME_LEVEL2, GAME_LEVEL3, GAME_OVER, GAME_MENU, GAME_PAUSE};
+enum GameMode {TITLE_SCREEN, GAME_LEVEL1, GAME_LEVEL2, GAME_LEVEL3, GAME_OVER, GAME_MENU, GAME_PAUSE, GAME_LOADING};
 GameMode save;  //global variable to save last level mode
+//hold each level once it has been loaded, keyed by its game mode
+std::map<GameMode, Level*> LEVEL_CACHE;
+
+//a level being loaded on a worker thread while the loading screen keeps the frame loop running
+class LevelLoad {
+public:
+    std::thread worker;
+    std::atomic<bool> finished{false};
+    Level* level = nullptr;
+    GameMode target = TITLE_SCREEN;
+};
+LevelLoad LEVEL_LOAD;
 //************************************
 //Game class definitions end here
 //************************************
@@ -146,6 +321,7 @@ GameMode save;  //global variable to save last level mode
 //plays death sound
 void Die(GameMode& mode) {
     Mix_HaltMusic();                    //stop the music
+    pendingMusic.clear();               //and anything queued to fade in after it
     Mix_PlayChannel(-1, deathSound, 0);  //play death sound
     mode = GAME_OVER;                   //change game mode
 }
@@ -153,160 +329,286 @@ void Die(GameMode& mode) {
 //************************************
 //Custom Draw methods begin here
 //************************************
-void DrawTilemap(ShaderProgram& p, int textureID, GameState& state) {
-    std::vector<float> vertexData;
-    std::vector<float> texCoordData;
-    glm::mat4 newMatrix = glm::mat4(1.0f);
-    p.SetModelMatrix(newMatrix);
-    for(int x = 0; x < state.map.mapWidth; x++) {
-        for(int y = 0; y < state.map.mapHeight; y++) {
-            if(state.map.mapData[y][x] != 0) {
-                float u = (float)(((int)state.map.mapData[y][x]) % SPRITE_COUNT_X) / (float) SPRITE_COUNT_X;
-                float v = (float)(((int)state.map.mapData[y][x]) / SPRITE_COUNT_X) / (float) SPRITE_COUNT_Y;
-                float spriteWidth = 1.0f/(float)SPRITE_COUNT_X;
-                float spriteHeight = 1.0f/(float)SPRITE_COUNT_Y;
-                vertexData.insert(vertexData.end(), {
-                    TILE_SIZE * x, -TILE_SIZE * y,
-                    TILE_SIZE * x, (-TILE_SIZE * y)-TILE_SIZE,
-                    (TILE_SIZE * x)+TILE_SIZE, (-TILE_SIZE * y)-TILE_SIZE,
-                    TILE_SIZE * x, -TILE_SIZE * y,
-                    (TILE_SIZE * x)+TILE_SIZE, (-TILE_SIZE * y)-TILE_SIZE,
-                    (TILE_SIZE * x)+TILE_SIZE, -TILE_SIZE * y
-                });
-                texCoordData.insert(texCoordData.end(), {
-                    u, v,
-                    u, v+(spriteHeight),
-                    u+spriteWidth, v+(spriteHeight),
-                    
-                    u, v,
-                    u+spriteWidth, v+(spriteHeight),
-                    u+spriteWidth, v
-                });
+//submit every sprite Entity::Draw queued since the last call to the render queue at the given layer
+void Submit_Sprites(ShaderProgram& p, RenderLayer layer) {
+    if (INSTANCED_SPRITES) {
+        //the instanced batch draws itself when the queue reaches it
+        render_queue.SubmitCustom(RenderSortKey(layer, p.programID, SPRITE_SHEET), p, [&p]() { instanced_batch.Flush(p); });
+    } else {
+        sprite_batch.Submit(render_queue, p, layer);
+    }
+}
+//Input: chunk size in map cells and gamestate
+//computes the range of chunks that overlap the camera rectangle, unclamped
+void Visible_Chunks(int chunkSize, GameState& state, int* firstX, int* firstY, int* lastX, int* lastY) {
+    float chunkWorldSize = chunkSize * TILE_SIZE;
+    *firstX = (int)floorf(state.cameraLeft / chunkWorldSize);
+    *lastX = (int)floorf(state.cameraRight / chunkWorldSize);
+    *firstY = (int)floorf(-state.cameraTop / chunkWorldSize);
+    *lastY = (int)floorf(-state.cameraBottom / chunkWorldSize);
+}
+//queue the level's static tile buffers whose chunks are on screen;
+//background, collision and decoration layers go behind the entities, foreground layers in front
+void DrawTilemap(ShaderProgram& p, int textureID, GameState& state, bool foreground) {
+    RenderLayer layer = foreground ? RENDER_FOREGROUND : RENDER_BACKGROUND;
+    Level& level = *state.level;
+    int firstX, firstY, lastX, lastY;
+    Visible_Chunks(TILEMAP_CHUNK_SIZE, state, &firstX, &firstY, &lastX, &lastY);
+    for (int y = std::max(firstY, 0); y <= std::min(lastY, level.chunkCountY - 1); y++) {
+        for (int x = std::max(firstX, 0); x <= std::min(lastX, level.chunkCountX - 1); x++) {
+            TilemapMeshes& meshes = level.chunks[y * level.chunkCountX + x];
+            (foreground ? meshes.foreground : meshes.background).Submit(render_queue, p, textureID, layer);
+        }
+    }
+    //streamed chunks are few, bounded by the world's keep radius, so test each one
+    if (level.world.IsOpen()) {
+        Visible_Chunks(level.world.chunkSize, state, &firstX, &firstY, &lastX, &lastY);
+        for (auto& chunk : level.chunkMeshes) {
+            int x = chunk.first % level.world.chunkCountX, y = chunk.first / level.world.chunkCountX;
+            if (x >= firstX && x <= lastX && y >= firstY && y <= lastY) {
+                (foreground ? chunk.second.foreground : chunk.second.background).Submit(render_queue, p, textureID, layer);
             }
         }
     }
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glEnableVertexAttribArray(p.positionAttribute);
-    glEnableVertexAttribArray(p.texCoordAttribute);
-    glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertexData.data());
-    glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoordData.data());
-    glDrawArrays(GL_TRIANGLES, 0, vertexData.size()/2);
-    glDisableVertexAttribArray(p.positionAttribute);
-    glDisableVertexAttribArray(p.texCoordAttribute);
 }
+//build meshes for chunks that just became resident and drop the meshes of evicted ones
+void Sync_Chunk_Meshes(Level& level) {
+    for (auto it = level.chunkMeshes.begin(); it != level.chunkMeshes.end();) {
+        if (level.world.resident[it->first] == nullptr) {
+            it->second.Release();
+            it = level.chunkMeshes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    int size = level.world.chunkSize;
+    for (int index : level.world.residentChunks) {
+        if (level.chunkMeshes.count(index) == 0) {
+            MapChunk* chunk = level.world.resident[index];
+            std::vector<const FlareTile*> layerTiles;
+            for (size_t i = 0; i < level.world.layers.size(); i++) {
+                layerTiles.push_back(&chunk->tiles[i * size * size]);
+            }
+            TilemapMeshes& meshes = level.chunkMeshes[index];
+            meshes.Append(level.world.layers, layerTiles, size, size, size, chunk->chunkX * size, chunk->chunkY * size);
+            meshes.Upload();
+        }
+    }
+}
+//queues UI text with its first letter centred on (x, y); each distinct string is built once and then drawn from text_cache
 void DrawText(ShaderProgram &p, int fontTexture, std::string text, float size, float spacing, float x, float y) {
-    glm::mat4 newMatrix = glm::mat4(1.0f);
-    newMatrix = glm::translate(newMatrix, glm::vec3(x, y, 1.0f));
-    p.SetModelMatrix(newMatrix);
-    
-    float character_size = 1.0/16.0f;
-    std::vector<float> vertexData;
-    std::vector<float> texCoordData;
-    for(int i=0; i < text.size(); i++) {
-        int spriteIndex = (int)text[i];
-        float texture_x = (float)(spriteIndex % 16) / 16.0f;
-        float texture_y = (float)(spriteIndex / 16) / 16.0f;
-        vertexData.insert(vertexData.end(), {
-            ((size+spacing) * i) + (-0.5f * size), 0.5f * size,
-            ((size+spacing) * i) + (-0.5f * size), -0.5f * size,
-            ((size+spacing) * i) + (0.5f * size), 0.5f * size,
-            ((size+spacing) * i) + (0.5f * size), -0.5f * size,
-            ((size+spacing) * i) + (0.5f * size), 0.5f * size,
-            ((size+spacing) * i) + (-0.5f * size), -0.5f * size,
-        });
-        texCoordData.insert(texCoordData.end(), {
-            texture_x, texture_y,
-            texture_x, texture_y + character_size,
-            texture_x + character_size, texture_y,
-            texture_x + character_size, texture_y + character_size,
-            texture_x + character_size, texture_y,
-            texture_x, texture_y + character_size,
-        }); }
-    glBindTexture(GL_TEXTURE_2D, fontTexture);
-    // draw this data (use the .data() method of std::vector to get pointer to data)
-    glEnableVertexAttribArray(p.positionAttribute);
-    glEnableVertexAttribArray(p.texCoordAttribute);
-    glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertexData.data());
-    glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoordData.data());
-    glDrawArrays(GL_TRIANGLES, 0, 6*text.size() );
-    //std::cout << "This is the array vertices number " << (6*text.size()) << std::endl;
-    // draw this yourself, use text.size() * 6 or vertexData.size()/2 to get number of vertices
-    glDisableVertexAttribArray(p.positionAttribute);
-    glDisableVertexAttribArray(p.texCoordAttribute);
-}
-//draw different tile maps once each time, depending on which game level is selected
-void Draw_Game_Level(GameState& state, GameMode& mode) {
-    //reset player, enemies, coins, doors, and map from previous levels
-    state.player.clear();
-    state.enemies.clear();
-    state.coins.clear();
-    state.doors.clear();
-    state.map = FlareMap();
-    
-    switch(mode) {
-        case GAME_LEVEL1:
-            state.map.Load(RESOURCE_FOLDER"Level_1.txt");
-            Play_Music("Level_1.mp3");
-            break;
-        case GAME_LEVEL2:
-            state.map.Load(RESOURCE_FOLDER"Level_2.txt");
-            Play_Music("Level_2.mp3");
-            break;
-        case GAME_LEVEL3:
-            state.map.Load(RESOURCE_FOLDER"Level_3.txt");
-            Play_Music("Level_3.mp3");
-            break;
-        default:
-            break;
+    text_cache.Submit(render_queue, p, RENDER_UI, fontTexture, FONT_REGION, text, size, spacing, x, y);
+}
+//load the whole compiled .flb level, or parse the Flare text map when it hasn't been built
+void Load_Whole_Map(Level& level, const std::string& name) {
+    if (!level.map.LoadBinary(std::string(RESOURCE_FOLDER) + name + ".flb") &&
+        !level.map.Load(std::string(RESOURCE_FOLDER) + name + ".txt")) {
+        std::cout << "Unable to load " << name << ".txt" << std::endl;
     }
-    for (FlareMapEntity &entity : state.map.entities) {
+}
+//stream the level when it was compiled as a chunked .flw world, otherwise load the whole map
+void Load_Map(Level& level, const std::string& name) {
+    if (level.world.Open(std::string(RESOURCE_FOLDER) + name + ".flw")) {
+        return;
+    }
+    Load_Whole_Map(level, name);
+}
+//lay out the whole map's tile geometry once, chunk by chunk; Upload_Level moves it into GL buffers.
+//Streamed levels build theirs per chunk as chunks arrive.
+void Build_Map_Meshes(Level& level) {
+    if (level.map.mapWidth > 0 && level.map.mapHeight > 0) {
+        level.chunkCountX = (level.map.mapWidth + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+        level.chunkCountY = (level.map.mapHeight + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+        level.chunks.resize(level.chunkCountX * level.chunkCountY);
+        for (int y = 0; y < level.chunkCountY; y++) {
+            for (int x = 0; x < level.chunkCountX; x++) {
+                int originX = x * TILEMAP_CHUNK_SIZE, originY = y * TILEMAP_CHUNK_SIZE;
+                std::vector<const FlareTile*> layerTiles;
+                for (const FlareMapLayer& layer : level.map.layers) {
+                    layerTiles.push_back(layer.tiles + originY * level.map.mapWidth + originX);
+                }
+                level.chunks[y * level.chunkCountX + x].Append(level.map.layers, layerTiles,
+                    std::min(TILEMAP_CHUNK_SIZE, level.map.mapWidth - originX), std::min(TILEMAP_CHUNK_SIZE, level.map.mapHeight - originY),
+                    level.map.mapWidth, originX, originY);
+            }
+        }
+    }
+}
+//a streamed world closes itself when a chunk can't be read; load the whole map in its place.
+//The entities already spawned from the world stay, since both files are compiled from the same map.
+void Fall_Back_To_Whole_Map(Level& level) {
+    std::cout << level.name << ".flw could not be read, loading the whole map instead" << std::endl;
+    Load_Whole_Map(level, level.name);
+    Build_Map_Meshes(level);
+}
+//load a level's map and spawn its entities; runs once per level on the loading thread,
+//so nothing here may touch OpenGL or SDL_mixer
+void Load_Level(Level& level, const std::string& name) {
+    level.name = name;
+    Load_Map(level, name);
+    level.music = name + ".mp3";
+    Build_Map_Meshes(level);
+    for (FlareMapEntity &entity : (level.world.IsOpen() ? level.world.entities : level.map.entities)) {
+        if (entity.typeId == FLARE_UNKNOWN_TYPE) {                      //skip types missing from Archetypes.txt
+            continue;
+        }
+        const EntityArchetype& archetype = ARCHETYPES[entity.typeId];
         Entity newEntity;
         newEntity.position = glm::vec3(entity.x*TILE_SIZE+TILE_SIZE, entity.y*-TILE_SIZE+TILE_SIZE/2, 1.0f);
-        newEntity.sprite = SheetSprite(SPRITE_SHEET, ENTITY_INDEX[entity.type]);
-        newEntity.size = glm::vec3(TILE_SIZE, TILE_SIZE, 1.0f);
-        
-        if (entity.type == "player") {                                  //moving player
-            newEntity.entity_type = ENTITY_PLAYER;
-            newEntity.isStatic = false;
-            state.player.push_back(newEntity);
-        } else if (entity.type == "door") {                             //static door
-            newEntity.entity_type = ENTITY_DOOR;
-            newEntity.isStatic = true;
-            state.doors.push_back(newEntity);
-        } else if (ENEMIES.find(entity.type) != ENEMIES.end()) {        //enemy
-            newEntity.entity_type = ENTITY_ENEMY;
-            if (entity.type == "spider") {                              //make spiders move vertically
-                newEntity.acceleration = glm::vec3(0.0f, -0.25f, 0.0f);
-            } else {                                                    //make all other enemies move horizontally
-                newEntity.acceleration = glm::vec3(0.25f, 0.0f, 0.0f);
-            }
-            newEntity.isStatic = false;
-            state.enemies.push_back(newEntity);
-        } else {                                                        //static coins
-            newEntity.entity_type = ENTITY_COIN;
-            newEntity.isStatic = true;
-            state.coins.push_back(newEntity);
+        newEntity.sprite = SheetSprite(SPRITE_SHEET, archetype.tile);
+        newEntity.size = glm::vec3(entity.width*TILE_SIZE, entity.height*TILE_SIZE, 1.0f);
+        newEntity.entity_type = archetype.kind;
+        newEntity.acceleration = archetype.acceleration;
+        newEntity.isStatic = (archetype.kind == ENTITY_COIN || archetype.kind == ENTITY_DOOR);
+        switch (archetype.kind) {
+            case ENTITY_PLAYER:                                         //moving player
+                level.player.push_back(newEntity);
+                break;
+            case ENTITY_DOOR:                                           //static door
+                level.doors.push_back(newEntity);
+                break;
+            case ENTITY_ENEMY:                                          //enemy moving along its archetype's acceleration
+                level.enemies.push_back(newEntity);
+                break;
+            case ENTITY_COIN:                                           //static coins
+                level.coins.push_back(newEntity);
+                break;
+        }
+    }
+    //read the chunks around the spawn point here rather than on the first frame
+    if (level.world.IsOpen() && !level.player.empty() &&
+        !level.world.Update((int)(level.player[0].position.x / TILE_SIZE), (int)(level.player[0].position.y / -TILE_SIZE), true)) {
+        Fall_Back_To_Whole_Map(level);
+    }
+}
+//the GL half of loading a level, run on the main thread once Load_Level is done
+void Upload_Level(Level& level) {
+    for (TilemapMeshes& chunk : level.chunks) {
+        chunk.Upload();
+    }
+    if (level.world.IsOpen()) {
+        Sync_Chunk_Meshes(level);
+    }
+}
+//after world.Update fails during play: drop the streamed chunks' meshes and switch to the whole map
+void Replace_Failed_World(Level& level) {
+    for (auto& chunk : level.chunkMeshes) {
+        chunk.second.Release();
+    }
+    level.chunkMeshes.clear();
+    Fall_Back_To_Whole_Map(level);
+    Upload_Level(level);
+}
+//Input: gamestate
+//centers the view matrix on the player and records the world rectangle it shows
+void Update_Camera(GameState& state) {
+    glm::vec3 center = state.player[0].position;
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+    viewMatrix = glm::translate(viewMatrix, glm::vec3(-center.x, -center.y, 0.0f));
+    RenderDevice::current->SetViewMatrix(textured_program, viewMatrix);
+    state.cameraLeft = center.x - VIEW_HALF_WIDTH;
+    state.cameraRight = center.x + VIEW_HALF_WIDTH;
+    state.cameraTop = center.y + VIEW_HALF_HEIGHT;
+    state.cameraBottom = center.y - VIEW_HALF_HEIGHT;
+}
+//start a cached level. Restarts and later visits copy its spawn state
+//into GameState without touching any files.
+void Draw_Game_Level(GameState& state, GameMode& mode) {
+    Level& level = *LEVEL_CACHE[mode];
+    state.level = &level;
+    state.player = level.player;
+    state.enemies = level.enemies;
+    state.coins = level.coins;
+    state.doors = level.doors;
+    Play_Music(level.music);
+    //a streamed level must have the chunks around the player resident before the first tick
+    if (level.world.IsOpen() && !state.player.empty()) {
+        if (level.world.Update((int)(state.player[0].position.x / TILE_SIZE), (int)(state.player[0].position.y / -TILE_SIZE), true)) {
+            Sync_Chunk_Meshes(level);
+        } else {
+            Replace_Failed_World(level);
         }
     }
+    if (!state.player.empty()) {
+        Update_Camera(state);
+    }
 }
 
-//function to load textures
-GLuint LoadTexture(const char *filePath) {
-    int w,h,comp;
-    unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-    if(image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
+//reads the archetype table, one "type tile kind accelX accelY" line per Flare object type.
+//Registers each type with FlareMap so loaded entities carry an index into ARCHETYPES.
+void Load_Archetypes(const std::string& fileName) {
+    std::ifstream infile(fileName);
+    std::string line;
+    while (std::getline(infile, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream lineStream(line);
+        std::string type, kind;
+        EntityArchetype archetype;
+        if (!(lineStream >> type >> archetype.tile >> kind)) {
+            continue;
+        }
+        lineStream >> archetype.acceleration.x >> archetype.acceleration.y;
+        if (kind == "player") {
+            archetype.kind = ENTITY_PLAYER;
+        } else if (kind == "enemy") {
+            archetype.kind = ENTITY_ENEMY;
+        } else if (kind == "door") {
+            archetype.kind = ENTITY_DOOR;
+        } else {
+            archetype.kind = ENTITY_COIN;
+        }
+        int id = FlareMap::RegisterEntityType(type);
+        if (id >= (int)ARCHETYPES.size()) {
+            ARCHETYPES.resize(id + 1);
+        }
+        ARCHETYPES[id] = archetype;
     }
-    GLuint retTexture;
-    glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    stbi_image_free(image);
-    return retTexture;
 }
+
+//reads the tileset descriptor into TILE_FLAGS. Each line is a tile index or first-last range
+//followed by its flags; tile 0 is empty and every tile not listed is solid.
+void Load_Tile_Flags(const std::string& fileName) {
+    TILE_FLAGS[0] = 0;
+    for (int i = 1; i < (1 << 16); i++) {
+        TILE_FLAGS[i] = TILE_SOLID;
+    }
+    std::ifstream infile(fileName);
+    std::string line;
+    while (std::getline(infile, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream lineStream(line);
+        std::string range, flag;
+        if (!(lineStream >> range)) {
+            continue;
+        }
+        int first = 0, last = 0;
+        if (sscanf(range.c_str(), "%d-%d", &first, &last) < 2) {
+            last = first;
+        }
+        Uint8 flags = 0;
+        while (lineStream >> flag) {
+            if (flag == "solid") {
+                flags |= TILE_SOLID;
+            } else if (flag == "lethal") {
+                flags |= TILE_LETHAL;
+            } else if (flag == "oneway") {
+                flags |= TILE_ONE_WAY;
+            } else if (flag == "ladder") {
+                flags |= TILE_LADDER;
+            } else if (flag == "trigger") {
+                flags |= TILE_TRIGGER;
+            }
+        }
+        for (int i = std::max(first, 1); i <= last && i < (1 << 16); i++) {
+            TILE_FLAGS[i] = flags;
+        }
+    }
+}
+
 //************************************
 //Custom Draw methods end here
 //************************************
@@ -334,6 +636,15 @@ void worldToTileCoordinates(float worldX, float worldY, int* gridX, int* gridY)
     *gridY = (int)(worldY / -TILE_SIZE);
 }
 
+//Input: gamestate and tile coordinates
+//returns the collision layer tile at a cell, from the streamed world when the level is streamed
+int Collision_Tile(GameState& state, int gridX, int gridY) {
+    if (state.level->world.IsOpen()) {
+        return state.level->world.GetCollisionTile(gridX, gridY);  //chunks that aren't resident read as empty
+    }
+    return state.level->map.GetCollisionTile(gridX, gridY);
+}
+
 //Input: two velocities and time
 float lerp(float v0, float v1, float t) {
     return (1.0-t)*v0 + t*v1;
@@ -375,29 +686,25 @@ bool check_collision_y(Entity& entity, GameState& state, GameMode& mode) {
     int gridX, gridY;
     //check entity top
     worldToTileCoordinates(entity.position.x, (entity.position.y + entity.size.y/2), &gridX, &gridY);
-    if (gridY < state.map.mapHeight && gridX < state.map.mapWidth && gridY >= 0 && gridX >= 0) {
-        int index = state.map.mapData[gridY][gridX];
-        if (index != 0) {    //check if tile is an empty space
-            if (LETHAL_TILE_INDEX.find(index) != LETHAL_TILE_INDEX.end() && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
-                Die(mode);
-            }
-            entity.collideTop = true;
-            penetration_y(entity, gridY);
-            return true;
-        }
+    Uint8 flags = TILE_FLAGS[Collision_Tile(state, gridX, gridY)];    //only the collision layer counts; cells outside the map read as empty
+    if ((flags & TILE_LETHAL) && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
+        Die(mode);
+    }
+    if (flags & TILE_SOLID) {    //one-way tiles can be jumped through from below
+        entity.collideTop = true;
+        penetration_y(entity, gridY);
+        return true;
     }
     //check entity bottom
     worldToTileCoordinates(entity.position.x, (entity.position.y - entity.size.y/2), &gridX, &gridY);
-    if (gridY < state.map.mapHeight && gridX < state.map.mapWidth && gridY >= 0 && gridX >= 0) {
-        int index = state.map.mapData[gridY][gridX];
-        if (index != 0) {    //check if tile is an empty space
-            if (LETHAL_TILE_INDEX.find(index) != LETHAL_TILE_INDEX.end() && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
-                Die(mode);
-            }
-            entity.collideBottom = true;
-            penetration_y(entity, gridY);
-            return true;
-        }
+    flags = TILE_FLAGS[Collision_Tile(state, gridX, gridY)];
+    if ((flags & TILE_LETHAL) && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
+        Die(mode);
+    }
+    if ((flags & TILE_SOLID) || ((flags & TILE_ONE_WAY) && entity.velocity.y <= 0.0f)) {    //land on one-way tiles only when falling
+        entity.collideBottom = true;
+        penetration_y(entity, gridY);
+        return true;
     }
     return false;
 }
@@ -408,29 +715,25 @@ bool check_collision_x(Entity& entity, GameState& state, GameMode& mode) {
     int gridX, gridY;
     //check entity left
     worldToTileCoordinates((entity.position.x - entity.size.x/2), entity.position.y, &gridX, &gridY);
-    if (gridY < state.map.mapHeight && gridX < state.map.mapWidth && gridY >= 0 && gridX >= 0) {
-        int index = state.map.mapData[gridY][gridX];
-        if (index != 0) {    //check if tile is an empty space
-            if (LETHAL_TILE_INDEX.find(index) != LETHAL_TILE_INDEX.end() && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
-                Die(mode);
-            }
-            entity.collideLeft = true;
-            penetration_x(entity, gridX);
-            return true;
-        }
+    Uint8 flags = TILE_FLAGS[Collision_Tile(state, gridX, gridY)];    //only the collision layer counts; cells outside the map read as empty
+    if ((flags & TILE_LETHAL) && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
+        Die(mode);
+    }
+    if (flags & TILE_SOLID) {
+        entity.collideLeft = true;
+        penetration_x(entity, gridX);
+        return true;
     }
     //check entity right
     worldToTileCoordinates((entity.position.x + entity.size.x/2), entity.position.y, &gridX, &gridY);
-    if (gridY < state.map.mapHeight && gridX < state.map.mapWidth && gridY >= 0 && gridX >= 0) {
-        int index = state.map.mapData[gridY][gridX];
-        if (index != 0) {    //check if tile is an empty space
-            if (LETHAL_TILE_INDEX.find(index) != LETHAL_TILE_INDEX.end() && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
-                Die(mode);
-            }
-            entity.collideRight = true;
-            penetration_x(entity, gridX);
-            return true;
-        }
+    flags = TILE_FLAGS[Collision_Tile(state, gridX, gridY)];
+    if ((flags & TILE_LETHAL) && entity.entity_type == ENTITY_PLAYER) {   //check if tile is a lethal tile
+        Die(mode);
+    }
+    if (flags & TILE_SOLID) {
+        entity.collideRight = true;
+        penetration_x(entity, gridX);
+        return true;
     }
     return false;
 }
@@ -558,15 +861,24 @@ void Update_Game_Level(GameState& state, GameMode& mode, const float elapsed) {
     for (Entity& entity: state.doors) {
         if (state.player[0].collidesWith(entity)) {
             //return to main menu
-            Play_Music("Title_Screen.mp3");
+            Play_Music(TITLE_MUSIC);
             mode = GAME_MENU;
         }
     }
     
     //Move the viewmatrix to follow the player
-    glm::mat4 viewMatrix = glm::mat4(1.0f);
-    viewMatrix = glm::translate(viewMatrix, glm::vec3(-(state.player[0].position.x), -(state.player[0].position.y), 0.0f));
-    textured_program.SetViewMatrix(viewMatrix);
+    Update_Camera(state);
+    
+    //stream world chunks in and out around the camera
+    if (state.level->world.IsOpen()) {
+        int gridX, gridY;
+        worldToTileCoordinates(state.player[0].position.x, state.player[0].position.y, &gridX, &gridY);
+        if (state.level->world.Update(gridX, gridY)) {
+            Sync_Chunk_Meshes(*state.level);
+        } else {
+            Replace_Failed_World(*state.level);
+        }
+    }
     
     //make the player's x width change as you increase/decrease x velocity.
     // map Y velocity 0.0 - 5.0 to 1.0 - 1.6 Y scale and 1.0 - 0.8 X scale
@@ -579,24 +891,116 @@ void Update_Game_Level(GameState& state, GameMode& mode, const float elapsed) {
 
 void Render_Game_Level(GameState& state) {
     //draw the player
-    state.player[0].Draw(textured_program);
+    state.player[0].Draw();
     //draw the enemies
     for (Entity& entity: state.enemies) {
-        entity.Draw(textured_program);
+        entity.Draw();
     }
     //draw the coins
     for (Entity& entity: state.coins) {
-        entity.Draw(textured_program);
+        entity.Draw();
     }
     //draw the doors
     for (Entity& entity: state.doors) {
-        entity.Draw(textured_program);
+        entity.Draw();
     }
+    //everything shares the sprite sheet, so this is a single draw call
+    Submit_Sprites(textured_program, RENDER_ENTITIES);
 }
 //************************************
 //Overall Game_Level update/render/process_input methods end here
 //************************************
 
+//************************************
+//Overall Loading_Screen update/render/process_input methods begin here
+//************************************
+//the file name each level mode loads from
+std::string Level_Name(GameMode level) {
+    switch(level) {
+        case GAME_LEVEL2:
+            return "Level_2";
+        case GAME_LEVEL3:
+            return "Level_3";
+        default:
+            return "Level_1";
+    }
+}
+//start a level: cached levels begin right away, others load on a worker thread behind the loading screen
+void Start_Level(GameState& state, GameMode& mode, GameMode level) {
+    if (LEVEL_CACHE.count(level) != 0) {
+        mode = level;
+        Draw_Game_Level(state, mode);
+        return;
+    }
+    Level* loading = new Level();
+    std::string name = Level_Name(level);
+    LEVEL_LOAD.level = loading;
+    LEVEL_LOAD.target = level;
+    LEVEL_LOAD.finished = false;
+    LEVEL_LOAD.worker = std::thread([loading, name]() {
+        Load_Level(*loading, name);
+        LEVEL_LOAD.finished = true;
+    });
+    mode = GAME_LOADING;
+}
+bool Process_Loading_Screen_Events(GameState& state, GameMode& mode) {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT || event.type == SDL_WINDOWEVENT_CLOSE) {
+            return true;
+        }
+    }
+    return false;
+}
+//swap the finished level in on the main thread, where its meshes can be uploaded
+void Update_Loading_Screen(GameState& state, GameMode& mode) {
+    if (!LEVEL_LOAD.finished) {
+        return;
+    }
+    LEVEL_LOAD.worker.join();
+    Upload_Level(*LEVEL_LOAD.level);
+    LEVEL_CACHE[LEVEL_LOAD.target] = LEVEL_LOAD.level;
+    LEVEL_LOAD.level = nullptr;
+    mode = LEVEL_LOAD.target;
+    Draw_Game_Level(state, mode);
+}
+//free a level's tile buffers, stop its world's loader thread and delete it
+void Free_Level(Level* level) {
+    for (TilemapMeshes& chunk : level->chunks) {
+        chunk.Release();
+    }
+    for (auto& chunk : level->chunkMeshes) {
+        chunk.second.Release();
+    }
+    level->world.Close();
+    delete level;
+}
+//free the level still loading, once its worker is done, and every cached level; must run before the render device is cleaned up
+void Free_Levels() {
+    if (LEVEL_LOAD.worker.joinable()) {
+        LEVEL_LOAD.worker.join();
+    }
+    if (LEVEL_LOAD.level != nullptr) {
+        Free_Level(LEVEL_LOAD.level);
+        LEVEL_LOAD.level = nullptr;
+    }
+    for (auto& cached : LEVEL_CACHE) {
+        Free_Level(cached.second);
+    }
+    LEVEL_CACHE.clear();
+}
+void Render_Loading_Screen() {
+    //Reset the view matrix to identity before drawing UI
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+    RenderDevice::current->SetViewMatrix(textured_program, viewMatrix);
+    int dots = (SDL_GetTicks() / 300) % 4;
+    loading_label.Set(FONTS, FONT_REGION, "Loading" + std::string(dots, '.'), 0.14f, -0.05f);
+    loading_label.Submit(render_queue, textured_program, RENDER_UI, -0.45f, 0.0f);
+}
+//************************************
+//Overall Loading_Screen update/render/process_input methods end here
+//************************************
+
 //************************************
 //Overall Title_Screen update/render/process_input methods begin here
 //************************************
@@ -623,7 +1027,7 @@ bool Process_Title_Screen_Events(GameState& state, GameMode& mode) {
 void Render_Title_Screen() {
     //Reset the view matrix to identity before drawing UI
     glm::mat4 viewMatrix = glm::mat4(1.0f);
-    textured_program.SetViewMatrix(viewMatrix);
+    RenderDevice::current->SetViewMatrix(textured_program, viewMatrix);
     DrawText(textured_program, FONTS, "Welcome to Jump", 0.14f, -0.05f, -1.1f, 0.5f);
     DrawText(textured_program, FONTS, "Press enter to play", 0.1f, -0.05f, -0.5f, 0.0f);
     DrawText(textured_program, FONTS, "Left/right arrow keys to move", 0.1f, -0.05f, -0.75f, -0.4f);
@@ -649,20 +1053,17 @@ bool Process_Game_Menu_Events(GameState& state, GameMode& mode) {
         } else if(event.type == SDL_KEYDOWN) {
             switch (event.key.keysym.scancode) {
                 case SDL_SCANCODE_1:        //press 1 to play level 1
-                    mode = GAME_LEVEL1;
-                    Draw_Game_Level(state, mode);
+                    Start_Level(state, mode, GAME_LEVEL1);
                     break;
                 case SDL_SCANCODE_2:        //press 2 to play level 2
-                    mode = GAME_LEVEL2;
-                    Draw_Game_Level(state, mode);
+                    Start_Level(state, mode, GAME_LEVEL2);
                     break;
                 case SDL_SCANCODE_3:        //press 3 to play level 3
-                    mode = GAME_LEVEL3;
-                    Draw_Game_Level(state, mode);
+                    Start_Level(state, mode, GAME_LEVEL3);
                     break;
                 case SDL_SCANCODE_4:        //press 4 to return to title screen
                     mode = TITLE_SCREEN;
-                    Play_Music("Title_Screen.mp3");
+                    Play_Music(TITLE_MUSIC);
                     break;
                 default:
                     break;
@@ -674,7 +1075,7 @@ bool Process_Game_Menu_Events(GameState& state, GameMode& mode) {
 void Render_Game_Menu_Screen() {
     //Reset the view matrix to identity before drawing UI
     glm::mat4 viewMatrix = glm::mat4(1.0f);
-    textured_program.SetViewMatrix(viewMatrix);
+    RenderDevice::current->SetViewMatrix(textured_program, viewMatrix);
     DrawText(textured_program, FONTS, "Press 1 to play level 1", 0.1f, -0.05f, -1.1f, 0.5f);
     DrawText(textured_program, FONTS, "Press 2 to play level 2", 0.1f, -0.05f, -0.5f, 0.0f);
     DrawText(textured_program, FONTS, "Press 3 to play level 3", 0.1f, -0.05f, -0.75f, -0.4f);
@@ -697,7 +1098,7 @@ bool Process_Game_Over_Events(GameState& state, GameMode& mode) {
         } else if(event.type == SDL_KEYDOWN) {
             switch (event.key.keysym.scancode) {
                 case SDL_SCANCODE_RETURN:       //press enter to return to game menu
-                    Play_Music("Title_Screen.mp3");
+                    Play_Music(TITLE_MUSIC);
                     mode = GAME_MENU;
                     break;
                 default:
@@ -710,7 +1111,7 @@ bool Process_Game_Over_Events(GameState& state, GameMode& mode) {
 void Render_Game_Over_Screen() {
     //Reset the view matrix to identity before drawing UI
     glm::mat4 viewMatrix = glm::mat4(1.0f);
-    textured_program.SetViewMatrix(viewMatrix);
+    RenderDevice::current->SetViewMatrix(textured_program, viewMatrix);
     DrawText(textured_program, FONTS, "Game Over", 0.1f, -0.05f, -1.1f, 0.5f);
     DrawText(textured_program, FONTS, "Press enter to return to menu", 0.1f, -0.05f, -0.5f, 0.0f);
 }
@@ -748,7 +1149,7 @@ bool Process_Game_Pause_Events(GameState& state, GameMode& mode) {
 void Render_Game_Pause_Screen() {
     //Reset the view matrix to identity before drawing UI
     glm::mat4 viewMatrix = glm::mat4(1.0f);
-    textured_program.SetViewMatrix(viewMatrix);
+    RenderDevice::current->SetViewMatrix(textured_program, viewMatrix);
     DrawText(textured_program, FONTS, "Press enter to unpause", 0.1f, -0.05f, -1.1f, 0.5f);
     DrawText(textured_program, FONTS, "Press 1 to return to main menu", 0.1f, -0.05f, -0.5f, 0.0f);
     DrawText(textured_program, FONTS, "Press 2 to quit game", 0.1f, -0.05f, -0.45, -0.6f);
@@ -758,50 +1159,181 @@ void Render_Game_Pause_Screen() {
 //************************************
 
 
+//************************************
+//Sprite benchmark methods begin here
+//************************************
+const int BENCHMARK_FRAMES = 120;
+//Input: number of sprites
+//draws that many random sprites from the sprite sheet for BENCHMARK_FRAMES frames on the current sprite path
+//and returns the average milliseconds per frame
+double Time_Sprites(int count) {
+    std::vector<Entity> sprites(count);
+    for (Entity& entity : sprites) {
+        entity.sprite = SheetSprite(SPRITE_SHEET, rand() % (SPRITE_COUNT_X * SPRITE_COUNT_Y));
+        entity.position = glm::vec3(((float)rand() / RAND_MAX * 2.0f - 1.0f) * VIEW_HALF_WIDTH,
+                                    ((float)rand() / RAND_MAX * 2.0f - 1.0f) * VIEW_HALF_HEIGHT, 0.0f);
+        entity.size = glm::vec3(TILE_SIZE, TILE_SIZE, 0.0f);
+    }
+    Uint64 start = 0;
+    for (int frame = -1; frame < BENCHMARK_FRAMES; frame++) {   //frame -1 warms up buffers and is not timed
+        if (frame == 0) {
+            glFinish();
+            start = SDL_GetPerformanceCounter();
+        }
+        RenderDevice::current->BeginFrame();
+        for (Entity& entity : sprites) {
+            entity.Draw();
+        }
+        Submit_Sprites(textured_program, RENDER_ENTITIES);
+        render_queue.Execute();
+        RenderDevice::current->EndFrame();
+        SDL_GL_SwapWindow(displayWindow);
+    }
+    glFinish();
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    return seconds * 1000.0 / BENCHMARK_FRAMES;
+}
+//compares the CPU-expanded batch against instanced drawing at 1k, 10k and 100k sprites, printing the results
+void Run_Sprite_Benchmark() {
+    const int COUNTS[] = {1000, 10000, 100000};
+    bool instancing = INSTANCED_SPRITES;
+    SDL_GL_SetSwapInterval(0);      //don't let vsync hide the difference
+    RenderDevice::current->SetViewMatrix(textured_program, glm::mat4(1.0f));
+    std::cout << "Sprites   batch ms/frame   instanced ms/frame" << std::endl;
+    for (int count : COUNTS) {
+        INSTANCED_SPRITES = false;
+        double batched = Time_Sprites(count);
+        std::cout << count << "   " << batched << "   ";
+        if (instancing) {
+            INSTANCED_SPRITES = true;
+            std::cout << Time_Sprites(count) << std::endl;
+        } else {
+            std::cout << "unsupported" << std::endl;
+        }
+    }
+    INSTANCED_SPRITES = instancing;
+    openGLDevice.stream.PrintStats();   //fence waits here mean the GPU fell a whole ring of frames behind
+}
+//************************************
+//Sprite benchmark methods end here
+//************************************
+
+
 //************************************
 //Overall Game methods begin here
 //************************************
+//Input: the texture of atlas.png, once ATLAS has loaded its region table
+//looks up the sprite sheet and font in the atlas
+void Use_Atlas(GLuint texture) {
+    ATLAS.textureID = texture;
+    SPRITE_SHEET = FONTS = ATLAS.textureID;
+    SPRITE_REGION = ATLAS.Region("tiles");
+    FONT_REGION = ATLAS.Region("font");
+}
+//loads atlas.png and its region table
+void Load_Atlas() {
+    ATLAS.Load(RESOURCE_FOLDER"atlas.txt");
+    Use_Atlas(texture_cache.Acquire(RESOURCE_FOLDER"atlas.png"));
+}
+//setup projection matrix (based on aspect ratio of screen)
+glm::mat4 Projection_Matrix() {
+    float projectionHeight = VIEW_HALF_HEIGHT;
+    float projectionWidth = VIEW_HALF_WIDTH;
+    float projectionDepth = 1.0f;
+    return glm::ortho(-projectionWidth, projectionWidth, -projectionHeight, projectionHeight, -projectionDepth, projectionDepth);
+}
+//Setup's file reads and decodes run as AssetLoader jobs while the main thread opens the window; each GL upload
+//then waits for just the job it needs. Audio files are only read there, since SDL_mixer isn't safe to call off
+//the main thread; they are decoded once SDL and the audio device are up. --trace-startup prints how the steps overlapped.
 void Setup(GameState& state) {
+    const char *SHADER_FILES[] = {"vertex_textured.glsl", "fragment_textured.glsl", "vertex.glsl", "fragment.glsl"};
+    std::string shaderSources[4];
+    TextureFile atlasFile;
+    const char *SOUND_FILES[] = {"jumpSound.wav", "coinSound.wav", "deathSound.wav"};
+    Mix_Chunk **soundChunks[] = {&jumpSound, &coinSound, &deathSound};
+    std::string soundFiles[3];
+    std::string titleFile;
+    AssetLoader loader;
+    int shaders = loader.Run("shaders", [&]() {
+        for (int i = 0; i < 4; i++) {
+            if (!AssetLoader::ReadFile(std::string(RESOURCE_FOLDER) + SHADER_FILES[i], shaderSources[i])) {
+                std::cout << "Error opening shader file:" << SHADER_FILES[i] << std::endl;
+            }
+        }
+    });
+    int atlas = loader.Run("atlas.png", [&]() { TextureCache::Read(RESOURCE_FOLDER"atlas.png", atlasFile); });
+    int atlasTable = loader.Run("atlas.txt", []() { ATLAS.Load(RESOURCE_FOLDER"atlas.txt"); });
+    int tables = loader.Run("Archetypes.txt, Tileset.txt", []() {
+        Load_Archetypes(RESOURCE_FOLDER"Archetypes.txt");
+        Load_Tile_Flags(RESOURCE_FOLDER"Tileset.txt");
+    });
+    int sounds = loader.Run("sound files", [&]() {
+        for (int i = 0; i < 3; i++) {
+            if (!AssetLoader::ReadFile(std::string(RESOURCE_FOLDER) + SOUND_FILES[i], soundFiles[i])) {
+                std::cout << "Error opening sound file:" << SOUND_FILES[i] << std::endl;
+            }
+        }
+    });
+    int music = loader.Run(TITLE_MUSIC, [&]() { AssetLoader::ReadFile(std::string(RESOURCE_FOLDER) + TITLE_MUSIC, titleFile); });
+
     // setup SDL, setup OpenGL, Set our projection matrix
-    SDL_Init(SDL_INIT_VIDEO);
-    displayWindow = SDL_CreateWindow("My Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL);
-    SDL_GLContext context = SDL_GL_CreateContext(displayWindow);
-    SDL_GL_MakeCurrent(displayWindow, context);
-    #ifdef _WINDOWS
-        glewInit();
-    #endif
-    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-    //load texture and untexture shaders
-    textured_program.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
-    untextured_program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
-
-    //setup projection matrix (based on aspect ratio of screen)
-    glm::mat4 projectionMatrix = glm::mat4(1.0f);
-    float aspectRatio = SCREEN_WIDTH/SCREEN_HEIGHT;
-    float projectionHeight = 1.0f;
-    float projectionWidth = 1.0f * aspectRatio;
-    float projectionDepth = 1.0f;
-    projectionMatrix = glm::ortho(-projectionWidth, projectionWidth, -projectionHeight, projectionHeight, -projectionDepth, projectionDepth);
+    loader.Trace("window and context", []() {
+        SDL_Init(SDL_INIT_VIDEO);
+        displayWindow = SDL_CreateWindow("My Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL);
+        SDL_GLContext context = SDL_GL_CreateContext(displayWindow);
+        SDL_GL_MakeCurrent(displayWindow, context);
+        #ifdef _WINDOWS
+            glewInit();
+        #endif
+        glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    });
+    //compile texture and untexture shaders
+    loader.Wait(shaders);
+    loader.Trace("compile shaders", [&]() {
+        textured_program.LoadFromSource(shaderSources[0], shaderSources[1]);
+        untextured_program.LoadFromSource(shaderSources[2], shaderSources[3]);
+    });
+
     //setup view matrix
     glm::mat4 viewMatrix = glm::mat4(1.0f);
 
     //use set the view and projection matrix to shader
-    glUseProgram(textured_program.programID);
-    textured_program.SetProjectionMatrix(projectionMatrix);
+    textured_program.Use();
+    RenderDevice::current->SetProjectionMatrix(textured_program, Projection_Matrix());
     textured_program.SetViewMatrix(viewMatrix);
+    INSTANCED_SPRITES = instanced_batch.Setup(textured_program);   //falls back to sprite_batch without instancing
     glEnable(GL_BLEND); //enable blending
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  //set alpha blend function
 
-    SPRITE_SHEET = LoadTexture(RESOURCE_FOLDER"spritesheet_rgba.png");
-    FONTS = LoadTexture(RESOURCE_FOLDER"font1.png");
+    loader.Wait(atlasTable);
+    loader.Wait(atlas);
+    loader.Trace("upload atlas", [&]() { Use_Atlas(texture_cache.Acquire(RESOURCE_FOLDER"atlas.png", atlasFile)); });
+    loader.Wait(tables);
 
-    Mix_OpenAudio( 44100, MIX_DEFAULT_FORMAT, 2, 4096 );
-    jumpSound = Mix_LoadWAV(RESOURCE_FOLDER"jumpSound.wav");
-    Mix_VolumeChunk(jumpSound, 16);
-    coinSound = Mix_LoadWAV(RESOURCE_FOLDER"coinSound.wav");
-    Mix_VolumeChunk(coinSound, 16);
-    deathSound = Mix_LoadWAV(RESOURCE_FOLDER"deathSound.wav");
-    Mix_VolumeChunk(deathSound, 16);
+    //sounds are decoded into the format the device opens with, so the device comes first
+    loader.Trace("audio device", []() { Mix_OpenAudio( 44100, MIX_DEFAULT_FORMAT, 2, 4096 ); });
+    loader.Wait(sounds);
+    loader.Trace("decode sounds", [&]() {
+        for (int i = 0; i < 3; i++) {
+            *soundChunks[i] = Mix_LoadWAV_RW(SDL_RWFromConstMem(soundFiles[i].data(), (int)soundFiles[i].size()), 1);
+            Mix_VolumeChunk(*soundChunks[i], 16);
+        }
+    });
+    loader.Wait(music);
+    loader.Trace("open " + TITLE_MUSIC, [&]() {
+        if (!titleFile.empty()) {
+            //the track streams from these bytes while it plays, so they live in MUSIC_FILES
+            std::string& bytes = MUSIC_FILES[TITLE_MUSIC];
+            bytes.swap(titleFile);
+            Mix_Music* track = Mix_LoadMUS_RW(SDL_RWFromConstMem(bytes.data(), (int)bytes.size()), 1);
+            if (track != nullptr) {     //otherwise Load_Music tries the file again when the title plays
+                MUSIC_CACHE[TITLE_MUSIC] = track;
+            }
+        }
+    });
+    if (TRACE_STARTUP) {
+        loader.PrintTrace();
+    }
 }
 
 void Render(GameState& state, GameMode& mode) {
@@ -818,13 +1350,19 @@ void Render(GameState& state, GameMode& mode) {
         case GAME_PAUSE:
             Render_Game_Pause_Screen();
             break;
+        case GAME_LOADING:
+            Render_Loading_Screen();
+            break;
         case GAME_LEVEL1:
         case GAME_LEVEL2:
         case GAME_LEVEL3:
-            DrawTilemap(textured_program, SPRITE_SHEET, state);
+            DrawTilemap(textured_program, SPRITE_SHEET, state, false);
             Render_Game_Level(state);
+            DrawTilemap(textured_program, SPRITE_SHEET, state, true);
             break;
     }
+    //everything above was only queued; sort it by layer and state and draw it
+    render_queue.Execute();
 }
 void Update(GameState& state, GameMode& mode, const float elapsed) {
     switch(mode) {
@@ -833,6 +1371,9 @@ void Update(GameState& state, GameMode& mode, const float elapsed) {
         case GAME_LEVEL3:
             Update_Game_Level(state, mode, elapsed);
             break;
+        case GAME_LOADING:
+            Update_Loading_Screen(state, mode);
+            break;
         default:
             break;
     }
@@ -851,6 +1392,9 @@ bool ProcessInput(GameState& state, GameMode& mode) {
         case GAME_PAUSE:
             return Process_Game_Pause_Events(state, mode);
             break;
+        case GAME_LOADING:
+            return Process_Loading_Screen_Events(state, mode);
+            break;
         case GAME_LEVEL1:
         case GAME_LEVEL2:
         case GAME_LEVEL3:
@@ -863,6 +1407,123 @@ bool ProcessInput(GameState& state, GameMode& mode) {
 //Overall game methods end here
 //************************************
 
+//************************************
+//Headless render methods begin here
+//************************************
+//the Setup work rendering needs, done through whatever device is current and without SDL
+void Headless_Setup() {
+    RenderDevice::current->SetProjectionMatrix(textured_program, Projection_Matrix());
+    Load_Atlas();
+    Load_Archetypes(RESOURCE_FOLDER"Archetypes.txt");
+    Load_Tile_Flags(RESOURCE_FOLDER"Tileset.txt");
+}
+//Input: gamestate, level mode
+//loads the level and copies in the same spawn state Draw_Game_Level does, without starting the music.
+//Returns false if the level has no player to center the camera on.
+bool Start_Headless_Level(GameState& state, GameMode level) {
+    Level* loaded = new Level();
+    Load_Level(*loaded, Level_Name(level));
+    Upload_Level(*loaded);
+    LEVEL_CACHE[level] = loaded;
+    state.level = loaded;
+    state.player = loaded->player;
+    state.enemies = loaded->enemies;
+    state.coins = loaded->coins;
+    state.doors = loaded->doors;
+    if (state.player.empty()) {
+        return false;
+    }
+    Update_Camera(state);
+    return true;
+}
+//Input: the most draw calls a level's first frame may take, 0 for no limit
+//renders the first frame of every level through a RecordingRenderDevice, without a window or GL context,
+//prints what each frame sent to the device and returns false if any level went over the limit
+bool Run_Render_Report(int maxDrawCalls) {
+    RecordingRenderDevice recorder;
+    RenderDevice::current = &recorder;
+    Headless_Setup();
+
+    bool withinBudget = true;
+    const GameMode LEVELS[] = {GAME_LEVEL1, GAME_LEVEL2, GAME_LEVEL3};
+    std::cout << "Level   draws   texture binds   skipped binds   skipped uploads   program changes   uniform uploads   vertex bytes"
+              << std::endl;
+    for (GameMode level : LEVELS) {
+        GameState state;
+        if (!Start_Headless_Level(state, level)) {
+            std::cout << Level_Name(level) << " has no player, skipped" << std::endl;
+            continue;
+        }
+        GameMode mode = level;
+        ShaderProgram::ResetCounters();     //so the skipped calls below are this frame's alone
+        recorder.BeginFrame();
+        Render(state, mode);
+        recorder.EndFrame();
+        const RenderFrameLog& frame = recorder.LastFrame();
+        std::cout << Level_Name(level) << "   " << frame.drawCalls << "   " << frame.textureBinds << "   "
+                  << ShaderProgram::skippedBinds << "   " << ShaderProgram::skippedUploads << "   "
+                  << frame.programChanges << "   " << frame.uniformUploads << "   " << frame.drawnVertexBytes << std::endl;
+        if (maxDrawCalls > 0 && frame.drawCalls > maxDrawCalls) {
+            std::cout << Level_Name(level) << " is over the budget of " << maxDrawCalls << " draw calls" << std::endl;
+            withinBudget = false;
+        }
+    }
+    texture_cache.PrintStats();
+    Free_Levels();
+    return withinBudget;
+}
+//how far a channel may stray from the golden image before the pixel counts as different
+const int GOLDEN_TOLERANCE = 2;
+//Input: folder holding the golden images
+//renders the title screen and the first frame of every level on the CPU through a SoftwareRenderDevice and
+//compares each with <folder>/<name>.png. A golden image that doesn't exist is written instead; a frame that
+//differs, or whose golden image is unreadable or the wrong size, is saved next to it as <name>.actual.png.
+//Returns false if any frame differed or couldn't be compared.
+bool Run_Render_Golden(const std::string& folder) {
+    SoftwareRenderDevice rasterizer((int)SCREEN_WIDTH, (int)SCREEN_HEIGHT);
+    RenderDevice::current = &rasterizer;
+    Headless_Setup();
+
+    bool matches = true;
+    const GameMode SCREENS[] = {TITLE_SCREEN, GAME_LEVEL1, GAME_LEVEL2, GAME_LEVEL3};
+    std::cout << "Frame   raster ms   differing pixels" << std::endl;
+    for (GameMode screen : SCREENS) {
+        GameState state;
+        std::string name = screen == TITLE_SCREEN ? "Title_Screen" : Level_Name(screen);
+        if (screen != TITLE_SCREEN && !Start_Headless_Level(state, screen)) {
+            std::cout << name << " has no player, skipped" << std::endl;
+            continue;
+        }
+        GameMode mode = screen;
+        rasterizer.BeginFrame();
+        Render(state, mode);
+        rasterizer.EndFrame();
+        std::string golden = folder + "/" + name + ".png";
+        int different = rasterizer.ComparePNG(golden, GOLDEN_TOLERANCE);
+        std::cout << name << "   " << rasterizer.rasterMilliseconds << "   ";
+        if (different == SoftwareRenderDevice::IMAGE_MISSING) {
+            bool written = rasterizer.WritePNG(golden);
+            std::cout << (written ? "no golden image, wrote " : "unable to write ") << golden << std::endl;
+            matches = matches && written;
+        } else if (different == SoftwareRenderDevice::IMAGE_INVALID) {
+            //never replace a reference that is there; a bad or wrong-size one has to be looked at
+            rasterizer.WritePNG(folder + "/" + name + ".actual.png");
+            std::cout << "unreadable or wrong size golden image " << golden << std::endl;
+            matches = false;
+        } else if (different > 0) {
+            rasterizer.WritePNG(folder + "/" + name + ".actual.png");
+            std::cout << different << std::endl;
+            matches = false;
+        } else {
+            std::cout << 0 << std::endl;
+        }
+    }
+    Free_Levels();
+    return matches;
+}
+//Headless render methods end here
+//************************************
+
 int main(int argc, char *argv[])
 {
     GameState state;
@@ -871,8 +1532,21 @@ int main(int argc, char *argv[])
     float accumulator = 0.0f;
     float lastFrameTicks = 0.0f;
     
+    //these run before Setup, so they need no display or GPU
+    if (argc > 1 && std::string(argv[1]) == "--render-report") {
+        return Run_Render_Report(argc > 2 ? atoi(argv[2]) : 0) ? 0 : 1;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--render-golden") {
+        return Run_Render_Golden(argv[2]) ? 0 : 1;
+    }
+    TRACE_STARTUP = argc > 1 && std::string(argv[1]) == "--trace-startup";
     Setup(state);
-    Play_Music("Title_screen.mp3");
+    if (argc > 1 && std::string(argv[1]) == "--sprite-benchmark") {
+        Run_Sprite_Benchmark();
+        done = true;
+    } else {
+        Play_Music(TITLE_MUSIC);
+    }
     
     while (!done) {
         float ticks = (float)SDL_GetTicks()/1000.0f;
@@ -880,6 +1554,7 @@ int main(int argc, char *argv[])
         lastFrameTicks = ticks;
         
         done = ProcessInput(state, mode);
+        Update_Music();
 
         elapsed += accumulator;
         if (elapsed < FIXED_TIMESTEP) {
@@ -892,10 +1567,22 @@ int main(int argc, char *argv[])
         }
         accumulator = elapsed;
         
-        glClear(GL_COLOR_BUFFER_BIT);
+        RenderDevice::current->BeginFrame();
         Render(state, mode);
+        RenderDevice::current->EndFrame();
         SDL_GL_SwapWindow(displayWindow);
+        ShaderProgram::ResetCounters();     //fold the frame's skipped calls into the totals printed at exit
     }
+    Free_Levels();
+    sprite_batch.Cleanup();
+    instanced_batch.Cleanup();
+    text_cache.Clear();
+    loading_label.Release();
+    render_queue.Cleanup();
+    texture_cache.Clear();
+    openGLDevice.stream.PrintStats();
+    ShaderProgram::PrintCounters();
+    openGLDevice.Cleanup();
     SDL_Quit();
     return 0;
 }
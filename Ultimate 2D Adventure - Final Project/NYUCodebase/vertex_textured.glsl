@@ -1,6 +1,12 @@
 attribute vec4 position;
 attribute vec2 texCoord;
 
+// Per-sprite placement (x, y, scaleX, scaleY) and sheet rect (u, v, width, height)
+// for InstancedSpriteBatch. Every other draw leaves them at the constant
+// (0, 0, 1, 1), which passes position and texCoord through unchanged.
+attribute vec4 instanceTransform;
+attribute vec4 instanceTexRect;
+
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
@@ -9,7 +15,8 @@ varying vec2 texCoordVar;
 
 void main()
 {
-	vec4 p = viewMatrix * modelMatrix  * position;
-    texCoordVar = texCoord;
+	vec4 placed = vec4(position.xy * instanceTransform.zw + instanceTransform.xy, position.zw);
+	vec4 p = viewMatrix * modelMatrix  * placed;
+    texCoordVar = instanceTexRect.xy + texCoord * instanceTexRect.zw;
 	gl_Position = projectionMatrix * p;
 }
\ No newline at end of file
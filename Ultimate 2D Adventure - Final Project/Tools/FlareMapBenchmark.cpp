@@ -0,0 +1,147 @@
+//************************************
+//FlareMap text loading benchmark. Writes a synthetic 4096x1024 Flare map and
+//times the old getline/istringstream parser against FlareMap::Load, single
+//threaded and with one decode thread per core.
+//
+//Build (from this folder):
+//  clang++ -std=c++11 -O2 -pthread -I../NYUCodebase FlareMapBenchmark.cpp ../NYUCodebase/FlareMap.cpp ../NYUCodebase/MappedFile.cpp -o flarebench
+//Usage:
+//  ./flarebench [width height]
+//************************************
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include "FlareMap.h"
+
+const char *BENCHMARK_FILE = "flarebench_map.txt";
+const int RUNS = 5;
+
+//writes a map with long runs of empty tiles and repeated ground tiles, like our levels
+void Write_Synthetic_Map(int width, int height) {
+    std::ofstream out(BENCHMARK_FILE);
+    out << "[header]\nwidth=" << width << "\nheight=" << height << "\ntilewidth=23\ntileheight=23\n\n";
+    out << "[layer]\ntype=layer\ndata=\n";
+    srand(1);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int tile = 0;
+            if (y > height / 2) {
+                tile = (rand() % 4 == 0) ? 1 + rand() % 900 : 587;
+            }
+            out << tile << (x + 1 < width || y + 1 < height ? "," : "");
+        }
+        out << "\n";
+    }
+    out << "\n";
+    for (int i = 0; i < 1000; i++) {
+        out << "[ObjectsLayer]\n# enemy\ntype=bee\nlocation=" << (i * 7) % width << "," << (i * 3) % height << ",1,1\n\n";
+    }
+}
+
+//the parser FlareMap used before, kept here as the baseline
+void Legacy_Load(const std::string& fileName, int& width, int& height, std::vector<unsigned int>& tiles) {
+    std::ifstream stream(fileName);
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (line == "[header]") {
+            while (std::getline(stream, line)) {
+                if (line == "") { break; }
+                std::istringstream sStream(line);
+                std::string key, value;
+                std::getline(sStream, key, '=');
+                std::getline(sStream, value);
+                if (key == "width") {
+                    width = std::atoi(value.c_str());
+                } else if (key == "height") {
+                    height = std::atoi(value.c_str());
+                }
+            }
+            tiles.assign((size_t)width * height, 0);
+        } else if (line == "[layer]") {
+            while (std::getline(stream, line)) {
+                if (line == "") { break; }
+                std::istringstream sStream(line);
+                std::string key, value;
+                std::getline(sStream, key, '=');
+                std::getline(sStream, value);
+                if (key == "data") {
+                    for (int y = 0; y < height; y++) {
+                        std::getline(stream, line);
+                        std::istringstream lineStream(line);
+                        std::string tile;
+                        for (int x = 0; x < width; x++) {
+                            std::getline(lineStream, tile, ',');
+                            unsigned int val = std::atoi(tile.c_str());
+                            tiles[y * width + x] = val > 0 ? val - 1 : 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+double Milliseconds_Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//best of RUNS loads with the given decode thread count
+double Time_FlareMap(unsigned int threads, FlareMap& result) {
+    FlareMap::parseThreads = threads;
+    double best = 1e9;
+    for (int i = 0; i < RUNS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        FlareMap map;
+        map.Load(BENCHMARK_FILE);
+        best = std::min(best, Milliseconds_Since(start));
+        result = std::move(map);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 4096, height = 1024;
+    if (argc == 3) {
+        width = std::atoi(argv[1]);
+        height = std::atoi(argv[2]);
+    }
+    Write_Synthetic_Map(width, height);
+
+    int legacyWidth = 0, legacyHeight = 0;
+    std::vector<unsigned int> legacyTiles;
+    double legacy = 1e9;
+    for (int i = 0; i < RUNS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        Legacy_Load(BENCHMARK_FILE, legacyWidth, legacyHeight, legacyTiles);
+        legacy = std::min(legacy, Milliseconds_Since(start));
+    }
+
+    FlareMap single, parallel;
+    double singleTime = Time_FlareMap(1, single);
+    double parallelTime = Time_FlareMap(0, parallel);
+    std::remove(BENCHMARK_FILE);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned int expected = legacyTiles[y * width + x];
+            if (single.GetTile(0, x, y) != expected || parallel.GetTile(0, x, y) != expected) {
+                std::cout << "Tile mismatch at " << x << "," << y << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::cout << width << "x" << height << " map, best of " << RUNS << " runs" << std::endl;
+    std::cout << "  getline/istringstream:  " << legacy << " ms" << std::endl;
+    std::cout << "  FlareMap, 1 thread:     " << singleTime << " ms (" << legacy / singleTime << "x)" << std::endl;
+    std::cout << "  FlareMap, " << std::thread::hardware_concurrency() << " threads:    " << parallelTime << " ms ("
+              << legacy / parallelTime << "x)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,129 @@
+//************************************
+//Level compiler: turns Flare .txt maps into the binary .flb format that
+//FlareMap::LoadBinary maps straight into memory, into a chunked .flw
+//world that ChunkedMap streams around the camera, or back into a run-length
+//encoded Flare .txt map.
+//
+//Build (from this folder):
+//  clang++ -std=c++11 -O2 -pthread -I../NYUCodebase LevelCompiler.cpp ../NYUCodebase/FlareMap.cpp ../NYUCodebase/ChunkedMap.cpp ../NYUCodebase/MappedFile.cpp -o flarec
+//Usage:
+//  ./flarec ../NYUCodebase/Level_1.txt ../NYUCodebase/Level_1.flb
+//  ./flarec big_world.txt ../NYUCodebase/Level_4.flw
+//  ./flarec exported.txt compact.txt
+//************************************
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include "FlareMap.h"
+#include "ChunkedMap.h"
+
+bool Ends_With(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+//writes a run-length encoded text map and parses it back to make sure nothing was lost
+int Compile_Text(const FlareMap& map, const char *fileName) {
+    if (!map.SaveText(fileName)) {
+        std::cout << "Unable to write " << fileName << std::endl;
+        return 1;
+    }
+    FlareMap check;
+    if (!check.Load(fileName) || check.mapWidth != map.mapWidth || check.mapHeight != map.mapHeight || check.layers.size() != map.layers.size() ||
+        check.entities.size() != map.entities.size()) {
+        std::cout << "Verification of " << fileName << " failed" << std::endl;
+        return 1;
+    }
+    for (int layer = 0; layer < (int)map.layers.size(); layer++) {
+        for (int y = 0; y < map.mapHeight; y++) {
+            for (int x = 0; x < map.mapWidth; x++) {
+                if (check.GetTile(layer, x, y) != map.GetTile(layer, x, y)) {
+                    std::cout << "Tile mismatch at " << x << "," << y << " of layer " << layer << " in " << fileName << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+    std::cout << map.mapWidth << "x" << map.mapHeight << " map -> " << fileName << std::endl;
+    return 0;
+}
+
+//writes a streamed world and reads every chunk back to make sure the game will accept it
+int Compile_World(const FlareMap& map, const char *fileName) {
+    if (!ChunkedMap::Save(map, fileName)) {
+        std::cout << "Unable to write " << fileName << std::endl;
+        return 1;
+    }
+    ChunkedMap check;
+    if (!check.Open(fileName) || check.mapWidth != map.mapWidth || check.mapHeight != map.mapHeight ||
+        check.layers.size() != map.layers.size() || check.collisionLayer != map.collisionLayer ||
+        check.entities.size() != map.entities.size()) {
+        std::cout << "Verification of " << fileName << " failed" << std::endl;
+        return 1;
+    }
+    check.loadRadius = check.keepRadius = std::max(check.chunkCountX, check.chunkCountY);
+    if (!check.Update(0, 0, true)) {
+        std::cout << "Verification of " << fileName << " failed: a chunk could not be read" << std::endl;
+        return 1;
+    }
+    for (int layer = 0; layer < (int)map.layers.size(); layer++) {
+        for (int y = 0; y < map.mapHeight; y++) {
+            for (int x = 0; x < map.mapWidth; x++) {
+                if (check.GetTile(layer, x, y) != map.GetTile(layer, x, y)) {
+                    std::cout << "Tile mismatch at " << x << "," << y << " of layer " << layer << " in " << fileName << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+    std::cout << map.mapWidth << "x" << map.mapHeight << " world in " << check.residentChunks.size() << " of "
+              << check.chunkCountX * check.chunkCountY << " chunks -> " << fileName << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        std::cout << "usage: " << argv[0] << " <level.txt> <level.flb|world.flw|level.txt>" << std::endl;
+        return 1;
+    }
+    FlareMap map;
+    if (!map.Load(argv[1])) {
+        std::cout << "Unable to load " << argv[1] << std::endl;
+        return 1;
+    }
+    if (Ends_With(argv[2], ".flw")) {
+        return Compile_World(map, argv[2]);
+    }
+    if (Ends_With(argv[2], ".txt")) {
+        return Compile_Text(map, argv[2]);
+    }
+    if (!map.SaveBinary(argv[2])) {
+        std::cout << "Unable to write " << argv[2] << std::endl;
+        return 1;
+    }
+    //read the file back to make sure the game will accept it
+    FlareMap check;
+    if (!check.LoadBinary(argv[2]) || check.mapWidth != map.mapWidth || check.mapHeight != map.mapHeight ||
+        check.layers.size() != map.layers.size() || check.collisionLayer != map.collisionLayer ||
+        check.entities.size() != map.entities.size()) {
+        std::cout << "Verification of " << argv[2] << " failed" << std::endl;
+        return 1;
+    }
+    for (int layer = 0; layer < (int)map.layers.size(); layer++) {
+        if (check.layers[layer].name != map.layers[layer].name || check.layers[layer].role != map.layers[layer].role) {
+            std::cout << "Layer " << layer << " header mismatch in " << argv[2] << std::endl;
+            return 1;
+        }
+        for (int y = 0; y < map.mapHeight; y++) {
+            for (int x = 0; x < map.mapWidth; x++) {
+                if (check.GetTile(layer, x, y) != map.GetTile(layer, x, y)) {
+                    std::cout << "Tile mismatch at " << x << "," << y << " of layer " << layer << " in " << argv[2] << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+    std::cout << argv[1] << " -> " << argv[2] << " (" << map.mapWidth << "x" << map.mapHeight << ", "
+              << map.layers.size() << " layers, " << map.entities.size() << " entities)" << std::endl;
+    return 0;
+}